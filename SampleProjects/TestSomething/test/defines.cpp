@@ -8,6 +8,38 @@ unittest(binary)
   assertEqual(100, B1100100);
 }
 
+unittest(board_traits)
+{
+  static_assert(ArduinoCIBoardTraits::isPin(13), "pin 13 should exist on every board we test");
+  assertEqual(NUM_SERIAL_PORTS, ArduinoCIBoardTraits::serialPorts());
+  assertEqual(F_CPU, ArduinoCIBoardTraits::cpuFrequency());
+  assertEqual(MOCK_PINS_COUNT, GODMODE()->digitalPin.size());
+  assertEqual(MOCK_PINS_COUNT, GODMODE()->interrupt.size());
+
+  // constant pins can be checked against the board when compiling
+  GODMODE()->reset();
+  GODMODE()->digitalPin.at<13>() = HIGH;
+  assertEqual(HIGH, digitalRead(13));
+
+  // a pin the board doesn't have goes nowhere, as in the Arduino core
+  if (ArduinoCIBoardTraits::pins() < 256) {
+    uint8_t missing = ArduinoCIBoardTraits::pins();
+    unsigned int allocated = GODMODE()->digitalPin.allocatedCount();
+    digitalWrite(missing, HIGH);
+    assertEqual(LOW, digitalRead(missing));
+    analogWrite(missing, 100);
+    assertEqual(0, analogRead(missing));
+    assertFalse(GODMODE()->digitalPin.allocated(missing));
+    assertEqual(allocated, GODMODE()->digitalPin.allocatedCount());
+  }
+#if defined(__AVR_ATmega328P__)
+  assertEqual(20, ArduinoCIBoardTraits::pins());
+  assertEqual(1024, ArduinoCIBoardTraits::eepromSize());
+  assertEqual(2048, ArduinoCIBoardTraits::sramSize());
+  assertEqual(16, clockCyclesPerMicrosecond());
+#endif
+}
+
 #ifdef __AVR__
 #define DDRE      _SFR_IO8(0x02)
 
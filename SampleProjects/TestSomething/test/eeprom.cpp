@@ -75,6 +75,15 @@ unittest(array)
   assertEqual(10, a);
 }
 
+unittest(reset)
+{
+  EEPROM.write(0, 1);
+  EEPROM.write(EEPROM_SIZE - 1, 2);
+  state->reset();
+  assertEqual(255, EEPROM.read(0));
+  assertEqual(255, EEPROM.read(EEPROM_SIZE - 1));
+}
+
 #endif
 
 unittest_main()
@@ -1,7 +1,12 @@
 #include <ArduinoUnitTests.h>
 #include <Arduino.h>
 #include <SPI.h>
+#include <Wire.h>
 #include "fibonacciClock.h"
+#include <ci/Trace.h>
+#include <chrono>
+#include <thread>
+#include <vector>
 
 GodmodeState* state = GODMODE();
 
@@ -289,6 +294,514 @@ unittest(no_ops) {
   analogWriteResolution(5);
 }
 
+unittest(reset_only_restores_touched_state) {
+  digitalWrite(4, HIGH);
+  analogWrite(5, 77);
+  attachInterrupt(6, (void (*)(void))0, 3);
+  volatile uint8_t* port = state->pMmapPort(7);
+  *port = 9;
+  state->micros = 500;
+
+  state->reset();
+  assertEqual(1, *port);  // a register pointer kept from before sees the reset
+  assertEqual(LOW, state->digitalPin[4]);
+  assertEqual(1, state->digitalPin[4].historySize());
+  assertEqual(0, state->analogPin[5]);
+  assertEqual(1, state->analogPin[5].historySize());
+  assertFalse(state->interrupt[6].attached);
+  assertEqual(1, state->mmapPortValue(7));
+
+  // a pin reset without resetting the clock takes the current time as its starting point,
+  // even when it isn't looked at until later
+  state->micros = 1234;
+  state->resetPins();
+  state->micros = 9999;
+  unsigned long timestamp;
+  assertEqual(1, state->digitalPin[17].toTimestampArray(&timestamp, 1));
+  assertEqual(1234, timestamp);
+}
+
+unittest(pins_allocated_on_first_use) {
+  assertFalse(state->digitalPin.allocated(19));
+  unsigned int before = state->digitalPin.allocatedCount();
+  assertTrue(before < MOCK_PINS_COUNT);
+
+  digitalWrite(19, HIGH);
+  assertTrue(state->digitalPin.allocated(19));
+  assertEqual(before + 1, state->digitalPin.allocatedCount());
+  assertFalse(state->digitalPin.allocated(18));
+  assertFalse(state->analogPin.allocated(19));
+
+  // staying allocated across resets
+  state->reset();
+  assertTrue(state->digitalPin.allocated(19));
+  assertFalse(state->digitalPin.touched(19));
+  assertEqual(LOW, digitalRead(19));
+  assertTrue(state->digitalPin.touched(19));
+}
+
+unittest(scheduled_events) {
+  std::vector<unsigned long> fired;
+  state->scheduleAt(300, [&]() { fired.push_back(micros()); });
+  state->scheduleAt(100, [&]() { fired.push_back(micros()); });
+  state->scheduleIn(100, [&]() { fired.push_back(micros() + 1); });  // same time, posted later
+  unsigned long doomed = state->scheduleAt(200, [&]() { fired.push_back(0); });
+  state->scheduleAt(5000000, [&]() { fired.push_back(micros()); });
+  assertEqual(5, state->scheduledCount());
+  assertTrue(state->cancelScheduled(doomed));
+  assertFalse(state->cancelScheduled(doomed));
+
+  unsigned long next = 0;
+  assertTrue(state->nextScheduled(next));
+  assertEqual(100, next);
+
+  delayMicroseconds(250);
+  assertEqual(250, micros());
+  assertEqual(2, fired.size());
+  assertEqual(100, fired[0]);
+  assertEqual(101, fired[1]);
+
+  // events can post events, and delay() hops straight over idle time
+  state->scheduleIn(50, [&]() {
+    fired.push_back(micros());
+    state->scheduleIn(10, [&]() { fired.push_back(micros()); });
+  });
+  delay(10000);
+  assertEqual(10000250, micros());
+  assertEqual(6, fired.size());
+  assertEqual(300, fired[2]);
+  assertEqual(300, fired[3]);
+  assertEqual(310, fired[4]);
+  assertEqual(5000000, fired[5]);
+  assertFalse(state->nextScheduled(next));
+
+  state->scheduleIn(1, [&]() { fired.push_back(0); });
+  state->reset();
+  assertEqual(0, state->scheduledCount());
+}
+
+unittest(clock_auto_advance) {
+  // frozen by default
+  assertEqual(0, micros());
+  assertEqual(0, micros());
+
+  state->setClockAutoAdvance(10);
+  unsigned long start = millis();
+  int reads = 0;
+  while (millis() - start < 100) ++reads;
+  assertEqual(9998, reads);
+  assertEqual(100010, micros());
+
+  // polling jumps to the next event instead of ticking toward it
+  bool ready = false;
+  state->scheduleIn(3000000, [&]() { ready = true; });
+  state->setClockAutoAdvance(1, 50);
+  reads = 0;
+  while (!ready && millis() < 10000) ++reads;
+  assertTrue(ready);
+  assertEqual(50, reads);
+  assertEqual(3100011, micros());  // this read ticks too
+
+  // a delay() means the sketch isn't polling
+  state->scheduleIn(3000000, [&]() { ready = false; });
+  for (int i = 0; i < 100; ++i) {
+    micros();
+    if (i % 10 == 0) delayMicroseconds(1);
+  }
+  assertTrue(ready);
+
+  state->reset();
+  assertEqual(0, micros());
+  assertEqual(0, micros());
+}
+
+unittest(clock_sources) {
+  assertEqual(GODMODE_CLOCK_VIRTUAL, state->clockSourceType());
+
+  // a user callback, here a clock that moves along a fibonacci sequence on every read
+  state->overrideClockTruth(&fibMicros);
+  assertEqual(1, micros());
+  assertEqual(1, micros());
+  assertEqual(2, micros());
+  digitalWrite(2, HIGH);
+  unsigned long stamps[2];
+  state->digitalPin[2].toTimestampArray(stamps, 2);
+  assertEqual(3, stamps[1]);
+
+  // delays can't move it, but they do run the events they wait through
+  bool ran = false;
+  bool tooLate = false;
+  state->scheduleAt(1000, [&]() { ran = true; });
+  state->scheduleAt(5000, [&]() { tooLate = true; });
+  delay(1);  // from 5
+  assertTrue(ran);
+  assertFalse(tooLate);
+  assertEqual(1000, micros());  // held there until the callback catches up, not back to 13
+
+  state->overrideClockTruth(nullptr);
+  assertEqual(GODMODE_CLOCK_VIRTUAL, state->clockSourceType());
+  unsigned long frozen = micros();
+  assertEqual(frozen, micros());
+
+  // real time, sped up 1000x: 1ms on the host is a second of virtual time
+  state->useWallClock(1000.0);
+  unsigned long start = micros();
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  assertMoreOrEqual(micros() - start, 2000000);
+  start = micros();
+  delay(3000);
+  assertMoreOrEqual(micros() - start, 3000000);
+
+  // events that fall due wait for a delay rather than running inside a read of the clock
+  ran = false;
+  state->scheduleIn(1000, [&]() { ran = true; });
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  micros();
+  digitalWrite(2, LOW);
+  assertFalse(ran);
+  delay(0);
+  assertTrue(ran);
+
+  state->reset();
+  assertEqual(GODMODE_CLOCK_VIRTUAL, state->clockSourceType());
+  assertEqual(0, micros());
+}
+
+unittest(pulse_in) {
+  // an ultrasonic ranger's echo: high from 100 to 680, then 1002 to 1250
+  PinHistory<bool>& echo = state->digitalPin[7];
+  echo.setInputAt(100, HIGH);
+  echo.setInputAt(680, LOW);
+  echo.setInputAt(1250, HIGH);
+  echo.setInputAt(1000, HIGH);  // out of order
+  echo.setInputAt(1000, LOW);   // replaces the HIGH at the same time
+  echo.setInputAt(1002, HIGH);
+  echo.setInputAt(1250, LOW);
+  assertEqual(5, echo.timeline().size());
+  assertEqual(HIGH, echo.inputAt(100));
+  assertEqual(LOW, echo.inputAt(99));
+  assertEqual(LOW, echo.inputAt(1001));
+
+  assertEqual(580, pulseIn(7, HIGH));
+  assertEqual(680, micros());
+
+  // the pulse doesn't end before the timeout
+  assertEqual(0, pulseIn(7, HIGH, 500));
+  assertEqual(1180, micros());
+
+  state->micros = 680;
+  assertEqual(248, pulseInLong(7, HIGH));
+  assertEqual(1250, micros());
+
+  // nothing more is coming
+  assertEqual(0, pulseIn(7, HIGH, 3000));
+  assertEqual(4250, micros());
+
+  // a pulse in progress is waited out
+  state->micros = 600;
+  assertEqual(248, pulseIn(7, HIGH));
+
+  // queued input lasts a microsecond a value, and is read as it goes by
+  state->reset();
+  bool queued[8] = {HIGH, HIGH, LOW, LOW, HIGH, HIGH, HIGH, LOW};
+  state->digitalPin[8].fromArray(queued, 8);
+  assertEqual(3, pulseIn(8, HIGH));
+  assertEqual(7, micros());
+  assertEqual(1, state->digitalPin[8].incoming().size());
+  assertEqual(0, pulseIn(8, HIGH, 100));
+  assertEqual(107, micros());
+
+  // a generator is searched too, up to where the timeline starts
+  state->reset();
+  state->digitalPin[9].setGenerator([](unsigned long t) { return t >= 50 && t < 80; });
+  assertEqual(30, pulseIn(9, HIGH));
+  assertEqual(80, micros());
+  state->digitalPin[9].setInputAt(200, HIGH);
+  state->digitalPin[9].setInputAt(260, LOW);
+  assertEqual(60, pulseIn(9, HIGH));
+  assertEqual(260, micros());
+
+  // square waves say where their edges are, so they aren't sampled: a thousand readings of a
+  // slow clock would otherwise take billions of calls
+  state->reset();
+  state->digitalPin[9].setGenerator(PWMSignal(64));  // high for 512 of every 2040us
+  assertEqual(512, pulseIn(9, HIGH));
+  assertEqual(2040 + 512, micros());
+  assertEqual(1528, pulseIn(9, LOW));
+  state->digitalPin[9].setGenerator(ClockSignal(400000));
+  for (int i = 0; i < 1000; ++i) assertEqual(200000, pulseIn(9, HIGH, 700000));
+  state->digitalPin[9].setGenerator(ClockSignal(4000000));
+  state->micros = 1;
+  assertEqual(0, pulseIn(9, HIGH, 1000000));
+  unsigned long edge;
+  assertFalse(state->digitalPin[9].nextInputAt(10, HIGH, edge, 1000));
+  assertTrue(state->digitalPin[9].nextInputAt(10, LOW, edge, 2000000));
+  assertEqual(2000000, edge);
+
+  // the timeout holds across the clock wrapping around
+  state->reset();
+  state->micros = ULONG_MAX - 100;
+  state->digitalPin[10].setInputAt(ULONG_MAX - 50, HIGH);
+  state->digitalPin[10].setInputAt(ULONG_MAX - 20, LOW);
+  assertEqual(30, pulseIn(10, HIGH, 1000));
+  assertEqual(ULONG_MAX - 20, micros());
+}
+
+unittest(snapshot_and_restore) {
+  // an expensive preamble
+  delay(7);
+  digitalWrite(4, HIGH);
+  state->digitalPin[5].fromAscii("hi", true);
+  state->analogPin[2] = 512;
+  state->spi.dataIn = "spi";
+  *state->pMmapPort(3) = 0;
+  Wire.resetMocks();
+  Wire.getMiso(14)->push_back(0x42);
+#if defined(HAVE_HWSERIAL0)
+  state->serialPort[0].dataIn = "abc";
+#endif
+#if defined(EEPROM_SIZE)
+  state->eeprom[3] = 9;
+#endif
+  GodmodeState::Snapshot warm = state->snapshot();
+
+  // a test that wrecks everything
+  delay(100);
+  digitalWrite(4, LOW);
+  digitalRead(5);
+  state->analogPin[2] = 1;
+  state->spi.dataIn = "";
+  *state->pMmapPort(3) = 5;
+  Wire.getMiso(14)->clear();
+  Wire.getMosi(15)->push_back(0x01);
+#if defined(HAVE_HWSERIAL0)
+  Serial.read();
+#endif
+#if defined(EEPROM_SIZE)
+  state->eeprom[3] = 10;
+#endif
+
+  for (int round = 0; round < 2; ++round) {
+    state->restore(warm);
+    assertEqual(7000, micros());
+    assertEqual(HIGH, state->digitalPin[4]);
+    assertEqual(2, state->digitalPin[4].historySize());
+    assertEqual(16, state->digitalPin[5].queueSize());
+    assertEqual(512, analogRead(2));
+    assertEqual("spi", state->spi.dataIn);
+    assertEqual(0, state->mmapPortValue(3));
+    assertEqual(1, Wire.getMiso(14)->size());
+    assertEqual(0, Wire.getMosi(15)->size());
+#if defined(HAVE_HWSERIAL0)
+    assertEqual("abc", state->serialPort[0].dataIn);
+#endif
+#if defined(EEPROM_SIZE)
+    assertEqual(9, state->eeprom[3]);
+#endif
+
+    // changes after a restore don't reach the snapshot
+    digitalWrite(4, LOW);
+    digitalRead(5);
+#if defined(EEPROM_SIZE)
+    state->eeprom[3] = 11;
+#endif
+  }
+  Wire.resetMocks();
+}
+
+unittest(snapshot_keeps_references_good) {
+  // tests hold on to pins and registers; those must stay the live ones
+  PinHistory<bool>& pin = state->digitalPin[4];
+  volatile uint8_t* port = state->pMmapPort(2);  // what portOutputRegister() gives on AVR
+  digitalWrite(4, HIGH);
+  *port = 0x11;
+  GodmodeState::Snapshot s = state->snapshot();
+
+  digitalWrite(4, LOW);
+  pin = HIGH;
+  pin = LOW;
+  *port = 0x22;
+  assertEqual(5, state->digitalPin[4].historySize());
+  assertEqual(&pin, &state->digitalPin[4]);
+
+  state->restore(s);
+  assertEqual(&pin, &state->digitalPin[4]);
+  assertEqual(2, pin.historySize());
+  assertEqual(HIGH, pin);
+  assertEqual(0x11, *port);
+  assertEqual(0x11, state->mmapPortValue(2));
+
+  // and the snapshot stays as it was taken, however often it is restored
+  pin = LOW;
+  state->restore(s);
+  assertEqual(2, pin.historySize());
+  state->reset();
+  state->restore(s);
+  assertEqual(2, pin.historySize());
+}
+
+unittest(state_is_per_thread) {
+  digitalWrite(4, HIGH);
+  delay(5);
+
+  GodmodeState* other = nullptr;
+  unsigned long otherMicros = 1;
+  int otherPin = HIGH;
+  std::thread t([&]() {
+    other = GODMODE();
+    otherMicros = micros();
+    otherPin = digitalRead(4);
+    digitalWrite(4, HIGH);
+    delay(100);
+#if defined(HAVE_HWSERIAL0)
+    Serial.print("other");
+#endif
+  });
+  t.join();
+
+  assertNotEqual(state, other);
+  assertEqual(0, otherMicros);
+  assertEqual(LOW, otherPin);
+  // nothing the other thread did leaked into this one
+  assertEqual(state, GODMODE());
+  assertEqual(5000, micros());
+  assertEqual(2, state->digitalPin[4].historySize());
+#if defined(HAVE_HWSERIAL0)
+  assertEqual("", state->serialPort[0].dataOut);
+#endif
+}
+
+unittest(trace_replay) {
+  FILE* f = fopen("trace_replay.csv", "w");
+  fputs("micros,channel,value\n"
+        "# a button press, a reading and a reply\n"
+        "0,D2,0\n"
+        "1000,D2,1\n"
+        "1000,A0,512\n"
+        "3000,D2,0\n"
+        "2000,S0,79\n"
+        "2000,S0,75\n"
+        "2500,W8,42\n", f);
+  fclose(f);
+
+  ArduinoCITrace csv;
+  assertTrue(csv.openCSV("trace_replay.csv"));
+  assertEqual(4, csv.channels().size());
+  assertTrue(csv.saveBinary("trace_replay.bin"));
+
+  ArduinoCITrace trace;
+  assertFalse(trace.openBinary("trace_replay.csv"));
+  assertTrue(trace.openBinary("trace_replay.bin"));
+  assertEqual(4, trace.channels().size());
+  trace.replay();
+
+  assertEqual(LOW, digitalRead(2));
+  assertEqual(0, analogRead(0));
+  state->advanceClock(1000);
+  assertEqual(HIGH, digitalRead(2));
+  assertEqual(512, analogRead(0));
+  assertEqual(0, Wire.getMiso(8)->size());
+  state->advanceClock(1000);
+#if defined(HAVE_HWSERIAL0)
+  assertEqual("OK", state->serialPort[0].dataIn);
+#endif
+  state->advanceClock(600);
+  assertEqual(1, Wire.getMiso(8)->size());
+  assertEqual(42, Wire.getMiso(8)->front());
+  state->advanceClock(1000);
+  assertEqual(LOW, digitalRead(2));
+  assertEqual(0, state->scheduledCount());
+
+  remove("trace_replay.csv");
+  remove("trace_replay.bin");
+}
+
+unittest(trace_replay_snapshot_and_wall_clock) {
+  FILE* f = fopen("trace_replay_snapshot.csv", "w");
+  fputs("1000,SPI,97\n"
+        "2000,SPI,98\n"
+        "3000,SPI,99\n", f);
+  fclose(f);
+
+  GodmodeState::Snapshot s = state->snapshot();
+  {
+    ArduinoCITrace trace;
+    assertTrue(trace.openCSV("trace_replay_snapshot.csv"));
+    trace.replay();
+    state->advanceClock(1500);
+    assertEqual("a", state->spi.dataIn);
+
+    // going back to a snapshot takes the feed back with it
+    s = state->snapshot();
+    state->advanceClock(1000);
+    assertEqual("ab", state->spi.dataIn);
+    state->restore(s);
+    assertEqual("a", state->spi.dataIn);
+    state->advanceClock(2000);
+    assertEqual("abc", state->spi.dataIn);
+
+    // and forward again, to a snapshot taken further along than the feed has since got
+    state->reset();
+    trace.replay();
+    GodmodeState::Snapshot a = state->snapshot();
+    state->advanceClock(2500);
+    GodmodeState::Snapshot b = state->snapshot();
+    assertEqual("ab", state->spi.dataIn);
+    state->restore(a);
+    state->advanceClock(1500);
+    assertEqual("a", state->spi.dataIn);
+    state->restore(b);
+    assertEqual("ab", state->spi.dataIn);
+    state->advanceClock(1000);
+    assertEqual("abc", state->spi.dataIn);
+
+    // a snapshot holding the feed's pending event can outlive the trace
+    state->reset();
+    trace.replay();
+    s = state->snapshot();
+    trace.detach();
+    assertEqual(0, state->scheduledCount());
+    state->restore(s);
+    assertEqual(1, state->scheduledCount());
+    state->advanceClock(5000);
+    assertEqual("", state->spi.dataIn);
+
+    // and the feed follows other clock sources
+    state->reset();
+    trace.replay();
+    state->useWallClock();
+    state->advanceClock(3000);
+    assertEqual("abc", state->spi.dataIn);
+    assertEqual(0, state->scheduledCount());
+    state->useVirtualClock();
+    state->reset();
+    trace.replay();
+    s = state->snapshot();
+  }
+  state->restore(s);
+  state->advanceClock(5000);
+  assertEqual("", state->spi.dataIn);
+
+  // Wire bytes go to the bus of the thread doing the replay
+  f = fopen("trace_replay_snapshot.csv", "w");
+  fputs("1000,W8,42\n", f);
+  fclose(f);
+  unsigned long thisThreadHad = Wire.getMiso(8)->size();
+  unsigned long otherThreadReceived = 0;
+  std::thread t([&]() {
+    ArduinoCITrace trace;
+    trace.openCSV("trace_replay_snapshot.csv");
+    trace.replay();
+    GODMODE()->advanceClock(1000);
+    otherThreadReceived = Wire.getMiso(8)->size();
+  });
+  t.join();
+  assertEqual(1, otherThreadReceived);
+  assertEqual(thisThreadHad, Wire.getMiso(8)->size());
+
+  remove("trace_replay_snapshot.csv");
+}
+
 #ifdef HAVE_HWSERIAL0
 
   void smartLightswitchSerialHandler(int pin) {
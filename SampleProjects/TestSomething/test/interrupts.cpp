@@ -4,6 +4,13 @@
 void myInterruptHandler() {
 }
 
+int isrCount = 0;
+int isrLevel = -1;
+void countingHandler() {
+  ++isrCount;
+  isrLevel = digitalRead(3);  // doesn't re-enter the ISR, even though it changes the pin
+}
+
 unittest(interrupts)
 {
   // these are meaningless for testing; just call the routine directly.
@@ -23,6 +30,51 @@ unittest(interrupt_attachment) {
   assertFalse(state->interrupt[0].attached);
 }
 
+unittest(isr_fires_on_matching_edges) {
+  GodmodeState *state = GODMODE();
+  state->reset();
+  isrCount = 0;
+
+  attachInterrupt(digitalPinToInterrupt(3), countingHandler, RISING);
+  digitalWrite(3, LOW);         // no edge
+  assertEqual(0, isrCount);
+  digitalWrite(3, HIGH);
+  assertEqual(1, isrCount);
+  assertEqual(HIGH, isrLevel);
+  state->digitalPin[3] = HIGH;  // no edge
+  state->digitalPin[3] = LOW;   // falling
+  assertEqual(1, isrCount);
+
+  // queued input fires as it is consumed
+  bool input[] = {HIGH, LOW, HIGH, LOW};
+  state->digitalPin[3].fromArray(input, 4);
+  assertEqual(1, isrCount);
+  digitalRead(3);
+  assertEqual(2, isrCount);
+  assertEqual(2, state->digitalPin[3].queueSize()); // the ISR's read consumed one more
 
+  attachInterrupt(digitalPinToInterrupt(3), countingHandler, CHANGE);
+  isrCount = 0;
+  state->digitalPin[3] = HIGH;  // the ISR left it LOW
+  state->digitalPin[3] = LOW;
+  state->digitalPin[3] = LOW;
+  assertEqual(2, isrCount);
+
+  attachInterrupt(digitalPinToInterrupt(3), countingHandler, FALLING);
+  isrCount = 0;
+  state->digitalPin[3] = HIGH;
+  state->digitalPin[3] = LOW;
+  assertEqual(1, isrCount);
+
+  detachInterrupt(digitalPinToInterrupt(3));
+  state->digitalPin[3] = LOW;
+  assertEqual(1, isrCount);
+
+  // a reset disarms it too
+  attachInterrupt(digitalPinToInterrupt(3), countingHandler, CHANGE);
+  state->reset();
+  state->digitalPin[3] = HIGH;
+  assertEqual(1, isrCount);
+}
 
 unittest_main()
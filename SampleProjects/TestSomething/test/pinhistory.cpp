@@ -1,5 +1,6 @@
 #include <ArduinoUnitTests.h>
 #include <Arduino.h>
+#include <algorithm>
 #include "fibonacciClock.h"
 
 unittest(pin_read_history_int) {
@@ -164,6 +165,298 @@ unittest(event_history) {
   }
 }
 
+bool isFortyFour(const MockEventQueue<int>::Event &e) { return e.data == 44; }
 
+unittest(iterate_history_in_place) {
+  resetFibClock();
+  PinHistory<int> phi(fibMicros);  // pin history int
+  for (int i = 0; i < 100; ++i)
+  {
+    phi = i;
+  }
+
+  int i = 0;
+  for (MockEventQueue<int>::const_iterator it = phi.begin(); it != phi.end(); ++it, ++i) {
+    assertEqual(i, it->data);
+  }
+  assertEqual(100, i);
+  assertEqual(100, std::distance(phi.begin(), phi.end()));
+
+  MockEventQueue<int>::const_iterator found = std::find_if(phi.begin(), phi.end(), isFortyFour);
+  assertFalse(found == phi.end());
+  assertEqual(44, found->data);
+
+  // queued input is visible too, and reading it doesn't consume it
+  int future[3] = {7, 8, 9};
+  phi.fromArray(future, 3);
+  i = 0;
+  for (MockEventQueue<int>::const_iterator it = phi.incoming().begin(); it != phi.incoming().end(); ++it, ++i) {
+    assertEqual(future[i], it->data);
+  }
+  assertEqual(3, phi.queueSize());
+}
+
+unittest(storage_transitions_only) {
+  PinHistory<bool> phb;
+  phb.setStorage(PIN_HISTORY_TRANSITIONS);
+  phb.reset(false);
+  bool writes[8] = {false, true, true, true, false, false, true, true};
+  for (int i = 0; i < 8; ++i) phb = writes[i];
+
+  bool expected[4] = {false, true, false, true};
+  assertEqual(4, phb.historySize());
+  assertTrue(phb.hasElements(expected, 4));
+  assertEqual(true, phb);
+}
+
+unittest(storage_ring) {
+  PinHistory<int> phi;
+  phi.setStorage(PIN_HISTORY_RING, 3);
+  for (int i = 0; i < 1000; ++i) phi = i;
+
+  int expected[3] = {997, 998, 999};
+  assertEqual(3, phi.historySize());
+  assertTrue(phi.hasElements(expected, 3));
+
+  // reads advance queued input through the same policy
+  int future[2] = {5, 6};
+  phi.fromArray(future, 2);
+  assertEqual(5, phi.retrieve());
+  assertEqual(6, phi.retrieve());
+  int expected2[3] = {999, 5, 6};
+  assertTrue(phi.hasElements(expected2, 3));
+}
+
+unittest(storage_current_only) {
+  PinHistory<int> phi;
+  phi.setStorage(PIN_HISTORY_CURRENT);
+  for (int i = 0; i < 1000; ++i) phi = i;
+  assertEqual(1, phi.historySize());
+  assertEqual(999, phi);
+}
+
+unittest(storage_change_trims_existing_history) {
+  PinHistory<int> phi;
+  int writes[6] = {1, 1, 2, 2, 2, 3};
+  for (int i = 0; i < 6; ++i) phi = writes[i];
+  assertEqual(PIN_HISTORY_FULL, phi.storage());
+  assertEqual(6, phi.historySize());
+
+  phi.setStorage(PIN_HISTORY_TRANSITIONS);
+  int expected[3] = {1, 2, 3};
+  assertEqual(3, phi.historySize());
+  assertTrue(phi.hasElements(expected, 3));
+
+  phi.setStorage(PIN_HISTORY_CURRENT);
+  assertEqual(1, phi.historySize());
+  assertEqual(3, phi);
+
+  // policy survives reset
+  phi.reset(0);
+  phi = 0;
+  assertEqual(1, phi.historySize());
+  assertEqual(PIN_HISTORY_CURRENT, phi.storage());
+}
+
+unittest(bulk_ascii_roundtrip) {
+  String message = "";
+  for (int i = 0; i < 2000; ++i) message += (char)(i * 7 + 3);
+
+  PinHistory<bool> phb;
+  phb.fromAscii(message, true);
+  assertEqual(16000, phb.queueSize());
+  assertEqual(message, phb.incomingToAscii(0, true));
+
+  phb.fromAscii(message, false); // keep queueing after the first copy
+  assertEqual(32000, phb.queueSize());
+  assertEqual(message, phb.incomingToAscii(16000, false));
+
+  // unaligned offsets: consume a few bits and decode from there
+  for (int i = 0; i < 13; ++i) phb.retrieve();
+  assertEqual(message.substring(2), phb.incomingToAscii(3, true).substring(0, 1998));
+  assertEqual(message, phb.incomingToAscii(16000 - 13, false));
+
+  // consuming all of the input leaves nothing to decode
+  for (int i = 0; i < 32000; ++i) phb.retrieve();
+  assertEqual(0, phb.queueSize());
+  assertEqual("", phb.incomingToAscii(0, true));
+  assertEqual(message, phb.toAscii(0, true).substring(0, 2000));
+  assertEqual(message, phb.toAscii(16000, false));
+}
+
+unittest(time_indexed_queries) {
+  GodmodeState* state = GODMODE();
+  state->reset();  // pin starts LOW at t=0
+
+  // a 1kHz square wave, 25% duty, for 1000 periods, written with redundant writes
+  for (int i = 0; i < 1000; ++i) {
+    digitalWrite(5, HIGH);
+    delayMicroseconds(100);
+    digitalWrite(5, HIGH);
+    delayMicroseconds(150);
+    digitalWrite(5, LOW);
+    delayMicroseconds(750);
+  }
+  PinHistory<bool> &pin = state->digitalPin[5];
+  assertEqual(3001, pin.historySize());
+
+  assertEqual(HIGH, pin.valueAt(0));  // the latest of the two writes at t=0
+  assertEqual(LOW,  pin.valueAt(260));
+  assertEqual(HIGH, pin.valueAt(12000));
+  assertEqual(HIGH, pin.valueAt(12249));
+  assertEqual(LOW,  pin.valueAt(12250));
+  assertEqual(LOW,  pin.valueAt(999999999));
+
+  assertEqual(6, pin.eventsBetween(12000, 14000).size());
+  int n = 0;
+  for (MockEventQueue<bool>::const_iterator it = pin.eventsBetween(12000, 14000).begin(); it != pin.eventsBetween(12000, 14000).end(); ++it, ++n) {
+    assertTrue(it->micros >= 12000);
+    assertTrue(it->micros < 14000);
+  }
+  assertEqual(6, n);
+  assertTrue(pin.eventsBetween(5, 6).empty());
+
+  assertEqual(1000, pin.risingEdges());
+  assertEqual(1000, pin.fallingEdges());
+  assertEqual(2, pin.risingEdges(10000, 12000));
+  assertEqual(2, pin.fallingEdges(10000, 12001));
+
+  assertEqual(0.25, pin.dutyCycle(0, 1000000));
+  assertEqual(0.25, pin.dutyCycle(500000, 600000));
+  assertEqual(1.0, pin.dutyCycle(12010, 12020));
+
+  assertEqual(1000, pin.pulseCount(HIGH));
+  assertEqual(250, pin.minPulseWidth(HIGH));
+  assertEqual(250, pin.maxPulseWidth(HIGH));
+  assertEqual(999, pin.pulseCount(LOW));
+  assertEqual(750, pin.minPulseWidth(LOW));
+  assertEqual(0, pin.maxPulseWidth(LOW, 12000, 12900)); // no complete low pulse in there
+}
+
+unittest(input_timeline) {
+  GodmodeState* state = GODMODE();
+  state->reset();
+
+  // a sensor sampled every 100us, read by a sketch at its own pace
+  const int n = 100000;
+  int* trace = new int[n];
+  for (int i = 0; i < n; ++i) trace[i] = i % 1024;
+  state->analogPin[0].setInputEvery(1000, 100, trace, n);
+  delete[] trace;
+
+  assertEqual(0, analogRead(0));  // not started yet
+  delayMicroseconds(1000);
+  assertEqual(0, analogRead(0));
+  delayMicroseconds(99);
+  assertEqual(0, analogRead(0));
+  assertEqual(0, analogRead(0));  // reading again doesn't move it along
+  delayMicroseconds(1);
+  assertEqual(1, analogRead(0));
+  delayMicroseconds(250);
+  assertEqual(3, analogRead(0));
+  delay(5000);                    // a long jump
+  assertEqual(50003 % 1024, analogRead(0));  // the sample taken at 5001300
+  state->micros = 1500;           // and back again
+  assertEqual(5, analogRead(0));
+
+  // digital input, set out of order, seen by the clock not by the number of reads
+  unsigned long times[] = {30, 10, 20};
+  bool values[] = {LOW, HIGH, LOW};
+  state->digitalPin[2].setInputAt(times, values, 3);
+  state->micros = 0;
+  assertEqual(LOW, digitalRead(2));
+  state->micros = 15;
+  assertEqual(HIGH, digitalRead(2));
+  assertEqual(HIGH, digitalRead(2));
+  state->micros = 25;
+  assertEqual(LOW, digitalRead(2));
+  assertEqual(3, state->digitalPin[2].historySize());  // reset value, then the two changes seen
+
+  // queued input comes first
+  bool queued[] = {HIGH, HIGH};
+  state->digitalPin[2].fromArray(queued, 2);
+  assertEqual(HIGH, digitalRead(2));
+  assertEqual(HIGH, digitalRead(2));
+  assertEqual(LOW, digitalRead(2));
+
+  // a trace loaded backward is sorted once, and the last value given for a time wins
+  for (int i = n - 1; i >= 0; --i) state->analogPin[1].setInputAt(i * 10, i);
+  state->analogPin[1].setInputAt(500, 7);
+  state->analogPin[1].setInputAt(500, 8);
+  assertEqual(n, state->analogPin[1].timeline().size());
+  assertEqual(8, state->analogPin[1].inputAt(505));
+  assertEqual(49, state->analogPin[1].inputAt(499));
+  assertEqual(n - 1, state->analogPin[1].inputAt(ULONG_MAX));
+  state->analogPin[1].setInputAt(15, 1000);
+  assertEqual(1000, state->analogPin[1].inputAt(19));
+  assertEqual(n + 1, state->analogPin[1].timeline().size());
+}
+
+unittest(signal_generators) {
+  GodmodeState* state = GODMODE();
+  state->reset();
+
+  state->analogPin[0].setGenerator(SineSignal(512, 500, 20000));  // 50Hz
+  assertEqual(512, analogRead(0));
+  delayMicroseconds(5000);
+  assertEqual(1012, analogRead(0));
+  delayMicroseconds(10000);
+  assertEqual(12, analogRead(0));
+  delay(7UL * 24 * 60 * 60 * 1000);  // a week later, still in phase
+  assertEqual(12, analogRead(0));
+  state->resetClock();
+
+  state->analogPin[1].setGenerator(RampSignal(0, 1000, 1000));
+  state->micros = 250;
+  assertEqual(250, analogRead(1));
+  state->micros = 1999;
+  assertEqual(999, analogRead(1));
+
+  NoiseSignal noise(10, 20, 42, 100);
+  state->analogPin[2].setGenerator(noise);
+  state->micros = 0;
+  int first = analogRead(2);
+  assertEqual(first, noise(99));
+  for (unsigned long t = 0; t < 100000; t += 100) {
+    assertMoreOrEqual(noise(t), 10);
+    assertLessOrEqual(noise(t), 20);
+  }
+  assertNotEqual(NoiseSignal(10, 20, 42)(12345), NoiseSignal(10, 20, 43)(12345)); // (for these seeds)
+  assertEqual(noise(12345), NoiseSignal(20, 10, 42, 100)(12345));  // bounds in either order
+  NoiseSignal wide(LONG_MIN, LONG_MAX, 7);
+  NoiseSignal nearlyWide(-2, LONG_MAX, 7);
+  bool negative = false;
+  for (unsigned long t = 0; t < 1000; ++t) {
+    negative = negative || wide(t) < 0;
+    assertMoreOrEqual(nearlyWide(t), -2);
+  }
+  assertTrue(negative);
+  assertEqual(5, NoiseSignal(5, 5)(999));
+
+  state->micros = 0;
+  state->digitalPin[3].setGenerator(PWMSignal(64));  // 25% of 2040us
+  assertEqual(HIGH, digitalRead(3));
+  state->micros = 511;
+  assertEqual(HIGH, digitalRead(3));
+  state->micros = 512;
+  assertEqual(LOW, digitalRead(3));
+  assertEqual(3, state->digitalPin[3].historySize());
+
+  state->digitalPin[4].setGenerator(ClockSignal(10));
+  state->micros = 15;
+  assertEqual(LOW, digitalRead(4));
+  state->digitalPin[4].setGenerator([](unsigned long t) { return t > 100; });  // any function of time
+  assertEqual(LOW, digitalRead(4));
+  state->micros = 101;
+  assertEqual(HIGH, digitalRead(4));
+
+  // a timeline, once started, takes over
+  state->digitalPin[4].setInputAt(200, LOW);
+  state->micros = 200;
+  assertEqual(LOW, digitalRead(4));
+
+  state->reset();
+  assertFalse(state->digitalPin[4].hasGenerator());
+}
 
 unittest_main()
@@ -1,4 +1,5 @@
 #include <ArduinoUnitTests.h>
+#include <iterator>
 #include <MockEventQueue.h>
 #include "fibonacciClock.h"
 
@@ -103,4 +104,101 @@ unittest(clocked_events)
 
 }
 
+unittest(many_events_interleaved)
+{
+  // enough events to span several internal storage chunks
+  MockEventQueue<int> q;
+  int next = 0;
+  int expected = 0;
+  for (int round = 0; round < 10; ++round) {
+    for (int i = 0; i < 150; ++i, ++next) q.push(next, next);
+    for (int i = 0; i < 100; ++i) {
+      assertEqual(expected, q.frontData());
+      assertEqual(expected, q.frontTime());
+      q.pop();
+      ++expected;
+    }
+    assertEqual(next - 1, q.backData());
+    assertEqual(next - expected, q.size());
+  }
+
+  MockEventQueue<int> q2(q);
+  assertEqual(q.size(), q2.size());
+  q.clear();
+  assertTrue(q.empty());
+  while (!q2.empty()) {
+    assertEqual(expected++, q2.frontData());
+    q2.pop();
+  }
+  assertEqual(next, expected);
+
+  q.push(7);
+  assertEqual(1, q.size());
+  assertEqual(7, q.frontData());
+  assertEqual(7, q.backData());
+}
+
+unittest(iteration)
+{
+  MockEventQueue<int> q;
+  assertTrue(q.begin() == q.end());
+
+  for (int i = 0; i < 200; ++i) q.push(i, i * 10);
+  for (int i = 0; i < 70; ++i) q.pop();
+
+  int expected = 70;
+  for (MockEventQueue<int>::const_iterator it = q.begin(); it != q.end(); ++it) {
+    assertEqual(expected, it->data);
+    assertEqual(expected * 10, (*it).micros);
+    ++expected;
+  }
+  assertEqual(200, expected);
+  assertEqual(130, q.size()); // iteration is non-destructive
+}
+
+unittest(packed_bool_events)
+{
+  // spans several words and a few compactions, with timestamps that don't fit a 32-bit delta
+  // (where unsigned long can hold one; elsewhere the gap is as big as it gets)
+  const unsigned long gap = sizeof(unsigned long) > 4 ? (unsigned long)0x100000000ULL : 0x80000000UL;
+  MockEventQueue<bool> q;
+  unsigned long t = 0;
+  for (unsigned long i = 0; i < 10000; ++i) {
+    t += (i == 5000) ? gap : (i % 7);
+    q.push(i % 3 == 0, t);
+  }
+  for (int i = 0; i < 4500; ++i) q.pop();
+  assertEqual(5500, q.size());
+
+  t = 0;
+  unsigned long expected = 0;
+  for (unsigned long i = 0; i < 10000; ++i) {
+    t += (i == 5000) ? gap : (i % 7);
+    if (i < 4500) continue;
+    MockEventQueue<bool>::Event e = q.at(i - 4500);
+    assertEqual(i % 3 == 0, e.data);
+    assertEqual(t, e.micros);
+    ++expected;
+  }
+  assertEqual(5500, expected);
+  assertEqual(q.at(500).micros, q.at(q.lowerBound(q.at(500).micros)).micros);
+  assertTrue(q.at(499).micros < q.at(500).micros);
+  assertEqual(500, q.upperBound(q.at(499).micros));
+
+  // iterators give events by value, so they work backward too
+  std::reverse_iterator<MockEventQueue<bool>::const_iterator> r(q.end());
+  assertEqual(q.backData(), r->data);
+  assertEqual(q.backTime(), (*r).micros);
+
+  // 'A' is 0x41, least significant bit first
+  MockEventQueue<bool> bits;
+  bool a[8] = {true, false, false, false, false, false, true, false};
+  for (int i = 0; i < 100; ++i) bits.push(a[i % 8], i);
+  assertEqual("AAAAAAAAAAAA", bits.toAscii(0, false));
+  assertEqual(0x41, bits.byteAt(64, false));
+  assertTrue(bits.hasBits(a, 8));
+  a[7] = true;
+  assertFalse(bits.hasBits(a, 8));
+}
+
 unittest_main()
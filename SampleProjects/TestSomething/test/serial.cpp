@@ -56,7 +56,59 @@ unittest(serial_ports)
     Serial.print((double)3.4);
     Serial.print((char)'a');
     Serial.print("b");
-    assertEqual("xyz123.4000000000ab", state->serialPort[0].dataOut);
+    assertEqual("xyz123.40ab", state->serialPort[0].dataOut);
+  }
+
+  unittest(print_number_formats)
+  {
+    GodmodeState* state = GODMODE();
+    state->serialPort[0].dataOut = "";
+
+    // as the Arduino core's Print: uppercase, and a sign only in base 10
+    Serial.print(255, HEX);
+    Serial.print(' ');
+    Serial.print(-1);
+    Serial.print(' ');
+    Serial.print(-255L, HEX);
+    Serial.print(' ');
+    Serial.print(65, 0);
+    assertEqual("FF -1 ", state->serialPort[0].dataOut.substring(0, 6));
+    assertEqual("FF01 A", state->serialPort[0].dataOut.substring(state->serialPort[0].dataOut.length() - 6));  // however wide long is
+
+    state->serialPort[0].dataOut = "";
+    Serial.println(1.999);
+    Serial.println(-2.5, 0);
+    Serial.println(3.14159, 4);
+    Serial.println(NAN);
+    Serial.println(-INFINITY);
+    Serial.println(5e9);
+    assertEqual("2.00\r\n-3\r\n3.1416\r\nnan\r\ninf\r\novf\r\n", state->serialPort[0].dataOut);
+  }
+
+  class WriteCounter : public DataStreamObserver {
+    public:
+      int runs;
+      int bytes;
+      WriteCounter() : DataStreamObserver(false, false), runs(0), bytes(0) {}
+      virtual String observerName() const { return "WriteCounter"; }
+      virtual void onBytes(const unsigned char* data, size_t count) { ++runs; bytes += count; }
+  };
+
+  unittest(bulk_writes_notify_once)
+  {
+    GodmodeState* state = GODMODE();
+    state->serialPort[0].dataOut = "";
+    WriteCounter counter;
+    counter.attach(&Serial);
+
+    Serial.print("hello, world");
+    Serial.println();
+    Serial.write('!');
+    assertEqual("hello, world\r\n!", state->serialPort[0].dataOut);
+    assertEqual(2, counter.runs);   // the single byte goes to onByte
+    assertEqual(14, counter.bytes);
+
+    counter.detach(&Serial);
   }
 
 #endif
@@ -44,4 +44,23 @@ unittest(print) {
   assertEqual("1.30", state->digitalPin[2].toAscii(1, bigEndian));
 }
 
+unittest(long_input)
+{
+  GodmodeState* state = GODMODE();
+  state->reset();
+
+  String message = "";
+  for (int i = 0; i < 3000; ++i) message += (char)('a' + (i % 26));
+  state->digitalPin[1].fromAscii(message, bigEndian);
+
+  SoftwareSerial ss(1, 2, flipLogic);
+  ss.listen();
+  for (int i = 0; i < 3000; ++i) {
+    assertEqual(3000 - i, ss.available());
+    assertEqual(message[i], ss.read());
+  }
+  assertEqual(0, ss.available());
+  assertEqual(-1, ss.read());
+}
+
 unittest_main()
@@ -55,4 +55,24 @@ unittest(library_tests_dtostrf)
   assertEqual(strncmp(buffer, "123.456", sizeof(buffer)), 0);
 }
 
+unittest(library_tests_ltoa_ultoa)
+{
+  char buf[72];
+  assertEqual("-2147483648", ltoa(-2147483648L, buf, 10));
+  assertEqual("7fffffff", ltoa(2147483647L, buf, 16));
+  assertEqual("ffffffff", ltoa(-1L, buf, 16) + strlen(buf) - 8);   // however wide long is
+  assertEqual("4294967295", ultoa(4294967295UL, buf, 10));
+  assertEqual("101", utoa(5U, buf, 2));
+  assertEqual("", itoa(5, buf, 1));
+}
+
+unittest(library_tests_dtostrf_padding)
+{
+  char buffer[32];
+  assertEqual("  -1.50", dtostrf(-1.5, 7, 2, buffer));
+  assertEqual("-1.50  |", strcat(dtostrf(-1.5, -7, 2, buffer), "|"));
+  assertEqual("3", dtostrf(2.5, 0, 0, buffer));
+  assertEqual("  nan", dtostrf(NAN, 5, 2, buffer));
+}
+
 unittest_main()
@@ -69,6 +69,48 @@ unittest(stream_parse)
 
 }
 
+unittest(stream_parse_lookahead_and_ignore) {
+  ArduinoCIStreamBuffer data;
+  unsigned long micros = 0;
+
+  Stream s;
+  s.mGodmodeDataIn = &data;
+  s.mGodmodeMicrosDelay = &micros;
+
+  // SKIP_NONE leaves the stream alone unless a number is next
+  data = "x12";
+  assertEqual(0, s.parseInt(SKIP_NONE));
+  assertEqual("x12", data);
+
+  // SKIP_WHITESPACE stops at the first other character, having consumed the whitespace
+  data = " \t\r\nx12";
+  assertEqual(0, s.parseInt(SKIP_WHITESPACE));
+  assertEqual("x12", data);
+  data = "  \n-12 ";
+  assertEqual(-12, s.parseInt(SKIP_WHITESPACE));
+  assertEqual(" ", data);
+
+  // the ignore character is skipped within a number, as with thousands separators
+  data = "1,234,567;";
+  assertEqual(1234567, s.parseInt(SKIP_ALL, ','));
+  assertEqual(";", data);
+  data = "1,234.5,0;";
+  assertEqual(1234.5, s.parseFloat(SKIP_ALL, ','));
+  assertEqual(";", data);
+
+  // a leading decimal point starts a float, and a second one ends it
+  data = "v=.25.5";
+  assertEqual(0.25, s.parseFloat());
+  assertEqual(".5", data);
+
+  // reading the number costs the same per-byte delay as reading it with read()
+  micros = 10;
+  unsigned long before = ::micros();
+  data = "ab42!";
+  assertEqual(42, s.parseInt());
+  assertEqual(40, ::micros() - before);
+}
+
 unittest(readStringUntil) {
   String data = "";
   unsigned long micros = 100;
@@ -81,4 +123,41 @@ unittest(readStringUntil) {
   assertEqual("abc", s.readStringUntil(':'));
   assertEqual("def", s.readStringUntil(':'));
 }
+
+unittest(stream_buffer_interleaved) {
+  ArduinoCIStreamBuffer data;
+  unsigned long micros = 0;
+
+  Stream s;
+  s.mGodmodeDataIn = &data;
+  s.mGodmodeMicrosDelay = &micros;
+
+  // feed and drain at different rates, so the buffer both reclaims and grows
+  unsigned long written = 0;
+  unsigned long readBack = 0;
+  bool inOrder = true;
+  for (int round = 0; round < 2000; ++round) {
+    for (int i = 0; i < 7; ++i) data += (char)('a' + written++ % 26);
+    for (int i = 0; i < (round % 2 ? 9 : 4) && s.available(); ++i) {
+      inOrder = inOrder && s.read() == 'a' + readBack++ % 26;
+    }
+  }
+  assertTrue(inOrder);
+  assertEqual(written - readBack, s.available());
+  assertEqual('a' + readBack % 26, data[0]);
+
+  data = "key=value;rest";
+  assertEqual(3, data.indexOf('='));
+  assertEqual("value;rest", data.substring(4));
+  assertEqual(0, strcmp("key=value;rest", data.c_str()));
+  assertTrue(data.startsWith("key"));
+  assertTrue(s.find("=", 1));
+  assertEqual("=value;rest", data);
+  char buf[8];
+  assertEqual(6, s.readBytesUntil(';', buf, 8));
+  assertEqual(";rest", data);
+  assertEqual(";rest", s.readString());
+  assertTrue(data.empty());
+}
+
 unittest_main()
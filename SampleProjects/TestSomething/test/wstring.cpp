@@ -52,7 +52,7 @@ unittest(string_comparison)
   assertEqual("3.14", String(3.1415, 2));
   assertEqual("-3.14", String(-3.1415, 2));
   assertEqual("0.14", String(0.1415, 2));
-  assertEqual("0.14", String(-0.1415, 2));
+  assertEqual("-0.14", String(-0.1415, 2));
 
   assertNotEqual(String("32767"), String(-32767));
   assertLess(String("a"), String("b"));
@@ -66,6 +66,73 @@ unittest(string_comparison)
   //assertEqual("3.141", String(3.1415));
 }
 
+unittest(string_number_formats)
+{
+  // as avr-libc's itoa family: lowercase, and two's complement outside base 10
+  assertEqual("ff", String(255, HEX));
+  assertEqual("11111111", String((unsigned char)255, BIN));
+  assertEqual("777", String(511U, OCT));
+  assertEqual("ffffffff", String(-1, HEX));
+  assertEqual("zz", String(1295, 36));
+  assertEqual("", String(10, 37));
+  assertEqual("-9223372036854775808", String(-9223372036854775807LL - 1));
+
+  // as avr-libc's dtostrf, padded to the decimal places plus two
+  assertEqual(" 5", String(5.0, 0));
+  assertEqual("2.00", String(1.999));
+  assertEqual("-0.00", String(-0.001));
+  assertEqual("12345678901.50", String(12345678901.5));
+  assertEqual(" nan", String(NAN));
+  assertEqual("-inf", String(-INFINITY));
+
+  String s = "n=";
+  s += 42;
+  s += ' ';
+  s += 1.5f;
+  assertEqual("n=42 1.50", s);
+}
+
+unittest(string_move_and_reserve)
+{
+  // long enough to be on the heap, so a move hands the buffer over
+  String a = "a string too long for any small-string buffer to hold";
+  const char *buffer = a.c_str();
+  String b(std::move(a));
+  assertTrue(buffer == b.c_str());
+  String c;
+  c = std::move(b);
+  assertTrue(buffer == c.c_str());
+
+  // reserve() holds capacity through growth, and never shrinks it
+  String d;
+  assertEqual(1, d.reserve(200));
+  const char *reserved = d.c_str();
+  for (int i = 0; i < 200; ++i) d += 'x';
+  assertTrue(reserved == d.c_str());
+  assertEqual(1, d.reserve(10));
+  assertMoreOrEqual(d.capacity(), 200);
+
+  // a chain of + builds on one buffer: the temporary on the left is moved along
+  String e = String("n=") + 42 + ", " + String(1.5) + '!';
+  assertEqual("n=42, 1.50!", e);
+  assertEqual("<<n=42, 1.50!", "<<" + e);
+  assertEqual("<<tail", "<<" + String("tail"));
+
+  // std::string on either side still goes through std::string's operator+
+  std::string stl = "stl";
+  String fromLeft = stl + String("+String");
+  String fromRight = String("String+") + stl;
+  assertEqual("stl+String", fromLeft);
+  assertEqual("String+stl", fromRight);
+  assertEqual("stl!", stl + '!');
+
+  String f;
+  f += String("moved in");
+  assertEqual("moved in", f);
+  f.concat(String(" and appended"));
+  assertEqual("moved in and appended", f);
+}
+
 unittest(string_mods)
 {
   String s = "  hey  ";
@@ -86,6 +153,57 @@ unittest(string_mods)
   assertEqual("Herld!", s);
 }
 
+unittest(string_replace_in_place)
+{
+  String s = "$GPGGA,,,$GPRMC,,";
+  s.replace(",,", ",0,");
+  assertEqual("$GPGGA,0,,$GPRMC,0,", s);
+  s.replace("$GP", "");
+  assertEqual("GGA,0,,RMC,0,", s);
+  s.replace("GGA", "gga");
+  assertEqual("gga,0,,RMC,0,", s);
+  s.replace(",", ";");
+  assertEqual("gga;0;;RMC;0;", s);
+  s.replace(';', ',');
+  assertEqual("gga,0,,RMC,0,", s);
+  s.replace("", "x");
+  assertEqual("gga,0,,RMC,0,", s);
+  s.replace("no match", "");
+  assertEqual("gga,0,,RMC,0,", s);
+
+  // matches are taken left to right, without overlapping
+  s = "aaaaa";
+  s.replace("aa", "b");
+  assertEqual("bba", s);
+  s = "aaa";
+  s.replace("aa", "xyz");
+  assertEqual("xyza", s);
+
+  // a long enough string is edited without moving to a new buffer
+  s = "AT+CMD=1\r\nAT+CMD=2\r\nAT+CMD=3\r\n";
+  const char *buffer = s.c_str();
+  s.replace("\r\n", "\n");
+  s.replace('=', ':');
+  s.trim();
+  assertEqual("AT+CMD:1\nAT+CMD:2\nAT+CMD:3", s);
+  s.remove(0, 3);
+  assertEqual("CMD:1\nAT+CMD:2\nAT+CMD:3", s);
+  assertTrue(buffer == s.c_str());
+
+  s = "\t \n";
+  s.trim();
+  assertEqual("", s);
+  s = "x";
+  s.remove(5);
+  s.remove(5, 1);
+  assertEqual("x", s);
+
+  assertTrue(String("Hello").equalsIgnoreCase("hELLO"));
+  assertFalse(String("Hello").equalsIgnoreCase("hELLO!"));
+  assertTrue(String("").equalsIgnoreCase(""));
+  assertTrue(String("abc").equals("abc"));
+}
+
 unittest(string_find)
 {
   String s = "in for a penny, in for a pound";
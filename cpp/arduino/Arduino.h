@@ -47,8 +47,7 @@ inline void yield() { _NOP(); }
 inline void interrupts() { _NOP(); }
 inline void noInterrupts() { _NOP(); }
 
-// TODO: correctly establish this per-board!
-#define F_CPU 1000000UL
+// F_CPU is established per-board in ci/BoardTraits.h
 #define clockCyclesPerMicrosecond() ( F_CPU / 1000000L )
 #define clockCyclesToMicroseconds(a) ( (a) / clockCyclesPerMicrosecond() )
 #define microsecondsToClockCycles(a) ( (a) * clockCyclesPerMicrosecond() )
@@ -6,17 +6,17 @@
 class Client : public Stream {
 public:
   Client() {
-    // The Stream mock defines a String buffer but never puts anything in it!
+    // The Stream mock defines an input buffer but never puts anything in it!
     if (!mGodmodeDataIn) {
-      mGodmodeDataIn = new String;
+      mGodmodeDataIn = new ArduinoCIStreamBuffer;
     }
   }
   Client(const Client &client) { // copy constructor
     if (this != &client) {       // not a self-assignment
       if (mGodmodeDataIn &&
           client.mGodmodeDataIn) { // replace what we previously had
-        delete mGodmodeDataIn;     // get rid of previous value
-        mGodmodeDataIn = new String(client.mGodmodeDataIn->c_str());
+        delete mGodmodeDataIn.buffer(); // get rid of previous value
+        mGodmodeDataIn = new ArduinoCIStreamBuffer(*client.mGodmodeDataIn.buffer());
       }
     }
   }
@@ -24,20 +24,20 @@ public:
     if (this != &client) {                  // not a self-assignment
       if (mGodmodeDataIn &&
           client.mGodmodeDataIn) { // replace what we previously had
-        delete mGodmodeDataIn;     // get rid of previous value
-        mGodmodeDataIn = new String(client.mGodmodeDataIn->c_str());
+        delete mGodmodeDataIn.buffer(); // get rid of previous value
+        mGodmodeDataIn = new ArduinoCIStreamBuffer(*client.mGodmodeDataIn.buffer());
       }
     }
     return *this;
   }
   ~Client() {
     if (mGodmodeDataIn) {
-      delete mGodmodeDataIn;
+      delete mGodmodeDataIn.buffer();
       mGodmodeDataIn = nullptr;
     }
   }
   virtual size_t write(uint8_t value) {
-    mGodmodeDataIn->concat(value);
+    mGodmodeDataIn->append((char)value);
     return 1;
   }
 
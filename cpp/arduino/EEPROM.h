@@ -10,33 +10,28 @@
   #error "EEPROM library not available for your board"
 #endif
 
+// stateless: every access goes to the EEPROM of the current thread's GODMODE()
 class EEPROMClass {
-private:
-  GodmodeState* state;
 public:
-  // constructor
-  EEPROMClass() {
-    state = GODMODE();
-  }
   // array subscript operator
   uint8_t &operator[](const int index) {
     assert(index < EEPROM_SIZE);
-    return state->eeprom[index];
+    return GODMODE()->eeprom[index];
   }
 
   uint8_t read(const int index) {
     assert(index < EEPROM_SIZE);
-    return state->eeprom[index];
+    return GODMODE()->eeprom[index];
   }
 
   void write(const int index, const uint8_t value) {
     assert(index < EEPROM_SIZE);
-    state->eeprom[index] = value;
+    GODMODE()->eeprom[index] = value;
   }
 
   void update(const int index, const uint8_t value) {
     assert(index < EEPROM_SIZE);
-    state->eeprom[index] = value;
+    GODMODE()->eeprom[index] = value;
   }
 
   uint16_t length() { return EEPROM_SIZE; }
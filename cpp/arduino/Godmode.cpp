@@ -1,42 +1,118 @@
+#include <string.h>
+#include <chrono>
+#include <thread>
 #include "Godmode.h"
 #include "HardwareSerial.h"
 #include "SPI.h"
 #include "Wire.h"
 
-GodmodeState* GODMODE() {
-  return GodmodeState::getInstance();
-}
-
-GodmodeState* GodmodeState::instance = nullptr;
+thread_local GodmodeState* GodmodeState::instance = nullptr;
 
-GodmodeState* GodmodeState::getInstance()
+GodmodeState* GodmodeState::createInstance()
 {
-    if (instance == nullptr)
-    {
-        instance = new GodmodeState();
-        for (int i = 0; i < MOCK_PINS_COUNT; ++i) {
-          instance->digitalPin[i].setMicrosRetriever(&GodmodeState::getMicros);
-          instance->analogPin[i].setMicrosRetriever(&GodmodeState::getMicros);
-        }
-    }
+    // frees the thread's state when the thread exits
+    struct Owner {
+      ~Owner() {
+        delete instance;
+        instance = nullptr;
+      }
+    };
+    static thread_local Owner owner;
+    (void)owner;
 
+    instance = new GodmodeState();
+    instance->wireBus = &Wire;
     return instance;
 }
 
 unsigned long millis() {
-  return GODMODE()->micros / 1000;
+  return GODMODE()->readClock() / 1000;
 }
 
 unsigned long micros() {
-  return GODMODE()->micros;
+  return GODMODE()->readClock();
 }
 
 void delay(unsigned long millis) {
-  GODMODE()->micros += millis * 1000;
+  GodmodeState* godmode = GODMODE();
+  godmode->clockWaited();
+  godmode->advanceClock(millis * 1000);
 }
 
 void delayMicroseconds(unsigned long micros) {
-  GODMODE()->micros += micros;
+  GodmodeState* godmode = GODMODE();
+  godmode->clockWaited();
+  godmode->advanceClock(micros);
+}
+
+void GodmodeState::tickClock() {
+  if (clockRunningEvents) return;
+  unsigned long next;
+  if (clockJumpPolls && ++clockPolls >= clockJumpPolls && nextScheduled(next) && next > micros) {
+    clockPolls = 0;
+    advanceClockTo(next);
+    return;
+  }
+  if (clockTick) advanceClock(clockTick);
+}
+
+static long long hostNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void GodmodeState::useWallClock(double scale) {
+  now();
+  clockSource = GODMODE_CLOCK_WALL;
+  clockCallback = nullptr;
+  clockScale = scale > 0 ? scale : 1.0;
+  clockWallBase = micros;
+  clockWallStartNanos = hostNanos();
+}
+
+void GodmodeState::syncClock() {
+  unsigned long t;
+  if (clockSource == GODMODE_CLOCK_WALL) {
+    t = clockWallBase + (unsigned long)((hostNanos() - clockWallStartNanos) / 1000.0 * clockScale);
+  } else if (clockCallback) {
+    t = clockCallback();
+  } else {
+    return;
+  }
+
+  // only reads the time: scheduled events wait for the next delay() or advanceClock(), so none
+  // runs in the middle of something that just wanted a timestamp.  events already run may have
+  // put the clock ahead of the source, so it doesn't go back until the source catches up
+  if ((long)(t - micros) > 0) micros = t;
+}
+
+void GodmodeState::waitForClock(unsigned long atMicros) {
+  if (clockSource != GODMODE_CLOCK_WALL) return;
+  unsigned long t = now();
+  if (t >= atMicros) return;
+  std::this_thread::sleep_for(std::chrono::nanoseconds((long long)((atMicros - t) * 1000.0 / clockScale)));
+}
+
+void GodmodeState::advanceClockTo(unsigned long atMicros) {
+  waitForClock(atMicros);
+  runEventsUntil(atMicros);
+  if (clockSource != GODMODE_CLOCK_VIRTUAL) {
+    runEventsUntil(now());  // the source has the final say, and may have moved on further
+  } else if (micros < atMicros) {
+    micros = atMicros;
+  }
+}
+
+void GodmodeState::runEventsUntil(unsigned long atMicros) {
+  // callbacks may schedule more events, or call delay() themselves; either way
+  // the heap is consistent each time around and the clock never goes backward
+  ArduinoCIScheduler::Event e;
+  bool wasRunningEvents = clockRunningEvents;
+  clockRunningEvents = true;
+  while (scheduler.popDue(atMicros, e)) {
+    if (micros < e.micros) micros = e.micros;
+    e.run();
+  }
+  clockRunningEvents = wasRunningEvents;
 }
 
 void randomSeed(unsigned long seed)
@@ -77,29 +153,102 @@ int analogRead(unsigned char pin) {
   return godmode->analogPin[pin].retrieve();
 }
 
+// move the clock to the first time that a digital pin's input has a value, no more than timeout
+// after start.  queued input comes first, each value lasting a microsecond as if a polling loop
+// read it; after that the timeline and generator are searched rather than polled
+static bool waitForInput(GodmodeState* godmode, PinHistory<bool>& p, bool value, unsigned long start, unsigned long timeout) {
+  while (!p.incoming().empty()) {
+    if (godmode->now() - start > timeout) return false;
+    if (p.incoming().frontData() == value) return true;
+    p.retrieve();
+    godmode->advanceClock(1);
+  }
+
+  unsigned long now = godmode->now();
+  unsigned long elapsed = now - start;
+  if (elapsed > timeout) return false;
+  if (p.inputAt(now) == value) return true;
+
+  unsigned long at;
+  if (!p.nextInputAt(now, value, at, timeout - elapsed)) return false;
+  godmode->advanceClockTo(at);
+  return true;
+}
+
+unsigned long pulseInLong(uint8_t pin, uint8_t state, unsigned long timeout) {
+  GodmodeState* godmode = GODMODE();
+  PinHistory<bool>& p = godmode->digitalPin[pin];
+  bool value = state != LOW;
+  unsigned long start = godmode->now();
+
+  // wait out a pulse in progress, then time the next one
+  if (waitForInput(godmode, p, !value, start, timeout) && waitForInput(godmode, p, value, start, timeout)) {
+    unsigned long begin = godmode->now();
+    if (waitForInput(godmode, p, !value, start, timeout)) return godmode->now() - begin;
+  }
+  unsigned long elapsed = godmode->now() - start;
+  if (elapsed < timeout) godmode->advanceClock(timeout - elapsed);
+  return 0;
+}
+
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout) {
+  return pulseInLong(pin, state, timeout);
+}
+
+// interrupt numbers are pin numbers here; see digitalPinToInterrupt
 void attachInterrupt(uint8_t interrupt, void ISR(void), uint8_t mode) {
   GodmodeState* godmode = GODMODE();
   godmode->interrupt[interrupt].attached = true;
   godmode->interrupt[interrupt].mode = mode;
+  godmode->interrupt[interrupt].isr = ISR;
+  godmode->digitalPin[interrupt].setChangeHandler(ISR ? &GodmodeState::dispatchInterrupt : nullptr, interrupt);
 }
 
 void detachInterrupt(uint8_t interrupt) {
   GodmodeState* godmode = GODMODE();
   godmode->interrupt[interrupt].attached = false;
+  godmode->interrupt[interrupt].isr = nullptr;
+  godmode->digitalPin[interrupt].setChangeHandler(nullptr, 0);
 }
 
-// Serial ports
+void GodmodeState::dispatchInterrupt(unsigned int pin, bool before, bool after) {
+  GodmodeState* godmode = GODMODE();
+  if (godmode->inInterrupt) return;
+
+  InterruptDef& i = godmode->interrupt[pin];
+  if (!i.attached || i.isr == nullptr) {
+    // the interrupts were reset since this pin's handler was set
+    godmode->digitalPin[pin].setChangeHandler(nullptr, 0);
+    return;
+  }
+
+  bool fire;
+  switch (i.mode) {
+    case CHANGE:  fire = before != after;  break;
+    case RISING:  fire = !before && after; break;
+    case FALLING: fire = before && !after; break;
+    case LOW:     fire = !after;           break;  // level-triggered: every LOW value the pin takes
+    default:      fire = false;
+  }
+  if (!fire) return;
+
+  godmode->inInterrupt = true;
+  i.isr();
+  godmode->inInterrupt = false;
+}
+
+// Serial ports.  These (like SPI and Wire) are per-thread, each bound to its own thread's state
 #if defined(HAVE_HWSERIAL0)
-  HardwareSerial Serial(&GODMODE()->serialPort[0].dataIn, &GODMODE()->serialPort[0].dataOut, &GODMODE()->serialPort[0].readDelayMicros);
+  thread_local HardwareSerial Serial(&GODMODE()->serialPort[0].dataIn, &GODMODE()->serialPort[0].dataOut, &GODMODE()->serialPort[0].readDelayMicros);
 #endif
 #if defined(HAVE_HWSERIAL1)
-  HardwareSerial Serial1(&GODMODE()->serialPort[1].dataIn, &GODMODE()->serialPort[1].dataOut, &GODMODE()->serialPort[1].readDelayMicros);
+  thread_local HardwareSerial Serial1(&GODMODE()->serialPort[1].dataIn, &GODMODE()->serialPort[1].dataOut, &GODMODE()->serialPort[1].readDelayMicros);
 #endif
 #if defined(HAVE_HWSERIAL2)
-  HardwareSerial Serial2(&GODMODE()->serialPort[2].dataIn, &GODMODE()->serialPort[2].dataOut, &GODMODE()->serialPort[2].readDelayMicros);
+  thread_local HardwareSerial Serial2(&GODMODE()->serialPort[2].dataIn, &GODMODE()->serialPort[2].dataOut, &GODMODE()->serialPort[2].readDelayMicros);
 #endif
 #if defined(HAVE_HWSERIAL3)
-  HardwareSerial Serial3(&GODMODE()->serialPort[3].dataIn, &GODMODE()->serialPort[3].dataOut, &GODMODE()->serialPort[3].readDelayMicros);
+  thread_local HardwareSerial Serial3(&GODMODE()->serialPort[3].dataIn, &GODMODE()->serialPort[3].dataOut, &GODMODE()->serialPort[3].readDelayMicros);
 #endif
 
 template <typename T>
@@ -109,14 +258,55 @@ inline std::ostream& operator << ( std::ostream& out, const PinHistory<T>& ph )
 }
 
 // defined in SPI.h
-SPIClass SPI = SPIClass(&GODMODE()->spi.dataIn, &GODMODE()->spi.dataOut);
+thread_local SPIClass SPI = SPIClass(&GODMODE()->spi.dataIn, &GODMODE()->spi.dataOut);
 
 // defined in Wire.h
-TwoWire Wire = TwoWire();
+thread_local TwoWire Wire = TwoWire();
 
 #if defined(EEPROM_SIZE)
   #include <EEPROM.h>
   EEPROMClass EEPROM;
 #endif
 
-volatile uint8_t __ARDUINO_CI_SFR_MOCK[1024];
+thread_local volatile uint8_t __ARDUINO_CI_SFR_MOCK[1024];
+
+struct GodmodeState::Peripherals {
+  TwoWire::Mocks wire;
+  uint8_t sfr[sizeof(__ARDUINO_CI_SFR_MOCK)];
+};
+
+GodmodeState::Snapshot GodmodeState::snapshot() const {
+  Snapshot s;
+  s.micros = micros;
+  s.seed = seed;
+  s.digitalPin = digitalPin.snapshot();
+  s.analogPin = analogPin.snapshot();
+  for (int i = 0; i < NUM_SERIAL_PORTS; ++i) s.serialPort[i] = serialPort[i];
+  s.interrupt = interrupt.snapshot();
+  s.spi = spi;
+  s.eeprom = eeprom.snapshot();
+  memcpy(s.mmapPorts, mmapPorts, sizeof(mmapPorts));
+  s.scheduler = scheduler;
+
+  Peripherals* p = new Peripherals();
+  wireBus->saveMocks(p->wire);
+  for (unsigned int i = 0; i < sizeof(p->sfr); ++i) p->sfr[i] = __ARDUINO_CI_SFR_MOCK[i];
+  s.peripherals.reset(p);
+  return s;
+}
+
+void GodmodeState::restore(const Snapshot& s) {
+  micros = s.micros;
+  seed = s.seed;
+  digitalPin.restore(s.digitalPin);
+  analogPin.restore(s.analogPin);
+  for (int i = 0; i < NUM_SERIAL_PORTS; ++i) serialPort[i] = s.serialPort[i];
+  interrupt.restore(s.interrupt);
+  spi = s.spi;
+  eeprom.restore(s.eeprom);
+  memcpy(mmapPorts, s.mmapPorts, sizeof(mmapPorts));
+  scheduler.assignEvents(s.scheduler);
+
+  wireBus->restoreMocks(s.peripherals->wire);
+  for (unsigned int i = 0; i < sizeof(s.peripherals->sfr); ++i) __ARDUINO_CI_SFR_MOCK[i] = s.peripherals->sfr[i];
+}
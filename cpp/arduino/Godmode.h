@@ -3,8 +3,14 @@
 #if defined(__AVR__)
 #include <avr/io.h>
 #endif
+#include <memory>
 #include "WString.h"
 #include "PinHistory.h"
+#include "ci/BoardTraits.h"
+#include "ci/LazyArray.h"
+#include "ci/Scheduler.h"
+#include "ci/Signals.h"
+#include "ci/StreamBuffer.h"
 
 // signal to the developer that we are in an arduino_ci mocked environment
 #define ARDUINO_CI_GODMODE
@@ -21,37 +27,23 @@ void delayMicroseconds(unsigned long micros);
 unsigned long millis();
 unsigned long micros();
 
-#define MOCK_PINS_COUNT 256
-
-#if (!defined NUM_SERIAL_PORTS)
-  #if defined(UBRR3H)
-    #define NUM_SERIAL_PORTS 4
-  #elif defined(UBRR2H)
-    #define NUM_SERIAL_PORTS 3
-  #elif defined(UBRR1H)
-    #define NUM_SERIAL_PORTS 2
-  #elif defined(UBRRH) || defined(UBRR0H)
-    #define NUM_SERIAL_PORTS 1
-  #else
-    #define NUM_SERIAL_PORTS 0
-  #endif
-#endif
+// where the mocked clock gets its time; see GodmodeState::useWallClock() and overrideClockTruth()
+enum GodmodeClockSource {
+  GODMODE_CLOCK_VIRTUAL,   // only moves when told to (delay(), scheduled events, auto-advance)
+  GODMODE_CLOCK_WALL,      // follows the host's monotonic clock, scaled
+  GODMODE_CLOCK_CALLBACK   // asks a user function
+};
 
-// different EEPROM implementations have different macros that leak out
-#if !defined(EEPROM_SIZE) && defined(E2END) && (E2END)
-  // public value indicates that feature is available
-  #define EEPROM_SIZE (E2END + 1)
-  // local array size
-  #define _EEPROM_SIZE EEPROM_SIZE
-#else
-  // feature is not available but we want to have the array so other code compiles
-  #define _EEPROM_SIZE (0)
-#endif
+// EEPROM is reset in pages of this many bytes
+#define _EEPROM_PAGE_SIZE 64
+#define _EEPROM_PAGES ((_EEPROM_SIZE + _EEPROM_PAGE_SIZE - 1) / _EEPROM_PAGE_SIZE)
+
+class TwoWire;
 
 class GodmodeState {
   private:
     struct PortDef {
-      String dataIn;
+      ArduinoCIStreamBuffer dataIn;
       String dataOut;
       unsigned long readDelayMicros;
     };
@@ -59,38 +51,122 @@ class GodmodeState {
     struct InterruptDef {
       bool attached;
       uint8_t mode;
+      void (*isr)(void);
     };
 
+    struct EEPROMPage {
+      uint8_t bytes[_EEPROM_PAGE_SIZE];
+    };
+
+    // resetters for the lazily-reset state below; see ci/LazyArray.h
+    template <typename T>
+    struct PinResetter {
+      T value;
+      unsigned long micros;
+      PinResetter() : value(), micros(0) {}
+      PinResetter(T v, unsigned long t) : value(v), micros(t) {}
+      void operator()(PinHistory<T>& pin) const {
+        pin.setMicrosRetriever(&GodmodeState::getMicros);
+        pin.reset(value, micros);
+      }
+    };
+
+    struct InterruptResetter {
+      void operator()(InterruptDef& i) const {
+        i.attached = false;
+        i.isr = nullptr;
+      }
+    };
+
+    struct EEPROMResetter {
+      void operator()(EEPROMPage& page) const {
+        for (int i = 0; i < _EEPROM_PAGE_SIZE; ++i) page.bytes[i] = 255;
+      }
+    };
+
+    // byte-addressable EEPROM, reset a page at a time on first touch
+    class EEPROMDef {
+      private:
+        typedef ArduinoCILazyArray<EEPROMPage, _EEPROM_PAGES, EEPROMResetter> Pages;
+        Pages mPages;
+      public:
+        typedef Pages::Snapshot Snapshot;
+        uint8_t& operator[](int index) { return mPages[index / _EEPROM_PAGE_SIZE].bytes[index % _EEPROM_PAGE_SIZE]; }
+        void reset() { mPages.reset(); }
+        Snapshot snapshot() const { return mPages.snapshot(); }
+        void restore(const Snapshot& s) { mPages.restore(s); }
+    };
+
+    typedef ArduinoCILazyArray<PinHistory<bool>, MOCK_PINS_COUNT, PinResetter<bool> > DigitalPins;
+    typedef ArduinoCILazyArray<PinHistory<int>, MOCK_PINS_COUNT, PinResetter<int> > AnalogPins;
+    typedef ArduinoCILazyArray<InterruptDef, MOCK_PINS_COUNT, InterruptResetter> Interrupts;
+
+    // state kept outside this class (Wire, SFR registers); defined in Godmode.cpp
+    struct Peripherals;
+
+    // a byte per pin, so resetting them all is cheaper than tracking them; and reset in place,
+    // so that pointers from portOutputRegister() see it
     uint8_t mmapPorts[MOCK_PINS_COUNT];
+    ArduinoCIScheduler scheduler;
+
+    // each thread gets its own world, created the first time that thread asks for it
+    static thread_local GodmodeState* instance;
+    static GodmodeState* createInstance();
+
+    bool inInterrupt;  // like the hardware, an ISR is not interrupted by another
+
+    TwoWire* wireBus;  // the Wire of the thread this state belongs to
+
+    // auto-advancing clock; see setClockAutoAdvance()
+    bool clockAuto;
+    unsigned long clockTick;
+    unsigned int clockJumpPolls;
+    unsigned int clockPolls;
+    bool clockRunningEvents;  // scheduled events see their own time, without auto-advance
+
+    // clock source; see useWallClock() and overrideClockTruth()
+    GodmodeClockSource clockSource;
+    unsigned long (*clockCallback)(void);
+    double clockScale;
+    unsigned long clockWallBase;    // virtual time when the wall clock was started
+    long long clockWallStartNanos;  // host time when the wall clock was started
 
-    static GodmodeState* instance;
+    void tickClock();
+    void syncClock();
+    void waitForClock(unsigned long atMicros);
+    void runEventsUntil(unsigned long atMicros);
 
   public:
     unsigned long micros;
     unsigned long seed;
     // not going to put pinmode here unless its really needed. can't think of why it would be
-    PinHistory<bool> digitalPin[MOCK_PINS_COUNT];
-    PinHistory<int> analogPin[MOCK_PINS_COUNT];
+    // pins, interrupts and EEPROM are allocated and reset lazily: only the ones a test touches cost anything
+    DigitalPins digitalPin;
+    AnalogPins analogPin;
     struct PortDef serialPort[NUM_SERIAL_PORTS];
-    struct InterruptDef interrupt[MOCK_PINS_COUNT]; // not sure how to get actual number
+    Interrupts interrupt; // not sure how to get actual number
     struct PortDef spi;
-    uint8_t eeprom[_EEPROM_SIZE];
+    EEPROMDef eeprom;
 
     void resetPins() {
-      for (int i = 0; i < MOCK_PINS_COUNT; ++i) {
-        digitalPin[i].reset(LOW);
-        analogPin[i].reset(0);
-      }
+      digitalPin.reset(PinResetter<bool>(LOW, micros));
+      analogPin.reset(PinResetter<int>(0, micros));
     }
 
     void resetClock() {
       micros = 0;
+      clockAuto = false;
+      clockTick = 0;
+      clockJumpPolls = 0;
+      clockPolls = 0;
+      clockRunningEvents = false;
+      clockSource = GODMODE_CLOCK_VIRTUAL;
+      clockCallback = nullptr;
     }
 
     void resetInterrupts() {
-      for (int i = 0; i < MOCK_PINS_COUNT; ++i) {
-        interrupt[i].attached = false;
-      }
+      interrupt.reset();
+      inInterrupt = false;
     }
 
     void resetPorts() {
@@ -115,11 +191,11 @@ class GodmodeState {
     }
 
     void resetEEPROM() {
-#if defined(EEPROM_SIZE)
-      for(int i = 0; i < EEPROM_SIZE; ++i) {
-        eeprom[i] = 255;
-      }
-#endif
+      eeprom.reset();
+    }
+
+    void resetScheduler() {
+      scheduler.clear();
     }
 
     void reset() {
@@ -130,25 +206,161 @@ class GodmodeState {
       resetSPI();
       resetMmapPorts();
       resetEEPROM();
+      resetScheduler();
       seed = 1;
     }
 
+    // Scheduled events: callbacks run when virtual time reaches them, in time order.
+    // delay() and delayMicroseconds() run whatever falls due along the way, and jump
+    // straight across the gaps between events.
+
+    // run a callback at an absolute time, returning an id for cancelScheduled()
+    unsigned long scheduleAt(unsigned long atMicros, const ArduinoCIScheduler::Callback& callback) {
+      return scheduler.post(atMicros, callback);
+    }
+
+    // run a function at an absolute time, without allocating; it is passed the context and the
+    // time it was due.  an owner keeps the context alive while the event (or a snapshot's copy
+    // of it) is pending
+    unsigned long scheduleAt(unsigned long atMicros, void (*function)(void*, unsigned long), void* context, const std::shared_ptr<void>& owner = nullptr) {
+      return scheduler.post(atMicros, function, context, owner);
+    }
+
+    // run a callback some time from now, returning an id for cancelScheduled()
+    unsigned long scheduleIn(unsigned long delayMicros, const ArduinoCIScheduler::Callback& callback) {
+      return scheduler.post(now() + delayMicros, callback);
+    }
+
+    // remove a pending event, returning whether it was still pending
+    bool cancelScheduled(unsigned long id) { return scheduler.cancel(id); }
+
+    // number of events waiting to run
+    unsigned long scheduledCount() const { return scheduler.size(); }
+
+    // the time the next event is due, or false if nothing is scheduled
+    bool nextScheduled(unsigned long& atMicros) const {
+      if (scheduler.empty()) return false;
+      atMicros = scheduler.nextMicros();
+      return true;
+    }
+
+    // move the clock forward to a given time, running events that fall due on the way.
+    // each event sees micros() at its own time (or later, if it was scheduled in the past)
+    void advanceClockTo(unsigned long atMicros);
+
+    // move the clock forward by an amount, running events that fall due on the way
+    void advanceClock(unsigned long deltaMicros) { advanceClockTo(now() + deltaMicros); }
+
+    // Make the clock move on its own, so that code busy-waiting on millis() or micros()
+    // finishes.  Each read of the clock advances it by microsPerRead (running any events
+    // that fall due).  If pollsBeforeJump is nonzero, that many reads in a row with no
+    // delay() in between are taken as a polling loop, and the clock jumps straight to the
+    // next scheduled event.  Zero for both turns it off again; reset() also turns it off.
+    void setClockAutoAdvance(unsigned long microsPerRead, unsigned int pollsBeforeJump = 0) {
+      clockAuto = microsPerRead || pollsBeforeJump;
+      clockTick = microsPerRead;
+      clockJumpPolls = pollsBeforeJump;
+      clockPolls = 0;
+    }
+
+    // the current time according to the clock source.  with the (default) virtual clock this is
+    // just the micros member; other sources update micros from wherever they get their time
+    inline unsigned long now() {
+      if (clockSource != GODMODE_CLOCK_VIRTUAL) syncClock();
+      return micros;
+    }
+
+    // the clock as read by millis() and micros(), advancing it first if it is set to do so
+    inline unsigned long readClock() {
+      if (clockAuto) tickClock();
+      return now();
+    }
+
+    // note that the sketch waited on purpose, so the next reads of the clock aren't a polling loop
+    inline void clockWaited() { clockPolls = 0; }
+
+    // A saved copy of the whole mocked world: clock, pins and their histories, interrupts,
+    // scheduled events, serial and SPI buffers, EEPROM, Wire slave buffers and memory-mapped registers.
+    // Pins, interrupts and EEPROM pages are shared with the live state until one side
+    // touches them, so taking and restoring a snapshot is cheap.
+    class Snapshot {
+      private:
+        friend class GodmodeState;
+        Snapshot() {}
+
+        unsigned long micros;
+        unsigned long seed;
+        DigitalPins::Snapshot digitalPin;
+        AnalogPins::Snapshot analogPin;
+        struct PortDef serialPort[NUM_SERIAL_PORTS];
+        Interrupts::Snapshot interrupt;
+        struct PortDef spi;
+        EEPROMDef::Snapshot eeprom;
+        uint8_t mmapPorts[MOCK_PINS_COUNT];
+        ArduinoCIScheduler scheduler;
+        std::shared_ptr<const Peripherals> peripherals;
+    };
+
+    // capture the current state, to return to later with restore()
+    Snapshot snapshot() const;
+
+    // return to a previously captured state.  the snapshot is unchanged, so it can be restored again
+    void restore(const Snapshot& s);
+
     int serialPorts() {
       return NUM_SERIAL_PORTS;
     }
 
-    // Using this for anything other than unit testing arduino_ci itself
-    // is unsupported at the moment
+    // Clock sources.  millis(), micros(), pin history timestamps, scheduled events and the delays
+    // of serial reads all take their time from the current source.  reset() returns to virtual.
+
+    // the default: time only moves when the sketch or the test moves it
+    void useVirtualClock() {
+      now();
+      clockSource = GODMODE_CLOCK_VIRTUAL;
+      clockCallback = nullptr;
+    }
+
+    // follow the host's elapsed time from now on, scaled (2.0 runs twice as fast as real time).
+    // delay() really waits, and runs the scheduled events that fell due by the time it returns
+    void useWallClock(double scale = 1.0);
+
+    // take the time from a function, e.g. for a clock that advances on every read.
+    // delay() can't move such a clock, so it only runs scheduled events.  the clock never goes
+    // backward: after events ahead of the function's time, it holds until the function catches
+    // up.  nullptr returns to virtual
     void overrideClockTruth(unsigned long (*getMicros)(void)) {
+      if (getMicros == nullptr) {
+        useVirtualClock();
+        return;
+      }
+      clockSource = GODMODE_CLOCK_CALLBACK;
+      clockCallback = getMicros;
+    }
+
+    GodmodeClockSource clockSourceType() const { return clockSource; }
+
+    // singleton pattern, one per thread.  inline so that every pin operation
+    // doesn't pay for a function call just to find the state
+    static inline GodmodeState* getInstance() {
+      GodmodeState* ret = instance;
+      return ret ? ret : createInstance();
     }
 
-    // singleton pattern
-    static GodmodeState* getInstance();
+    // the current thread's state if it has one, without creating it.  null before the first
+    // GODMODE() and again once the thread has torn its state down
+    static inline GodmodeState* existingInstance() { return instance; }
 
     static unsigned long getMicros() {
-      return instance->micros;
+      return instance->now();
     }
 
+    // the I2C bus mocked alongside this state: the Wire of the thread it belongs to
+    TwoWire* wire() const { return wireBus; }
+
+    // change handler for digital pins with an attached interrupt: runs the ISR if the change matches its mode
+    static void dispatchInterrupt(unsigned int pin, bool before, bool after);
+
     uint8_t* pMmapPort(uint8_t port) { return &mmapPorts[port]; }
     uint8_t mmapPortValue(uint8_t port) { return mmapPorts[port]; }
 
@@ -178,10 +390,12 @@ void detachInterrupt(uint8_t interrupt);
 // TODO: issue #26 to track the commanded state here
 inline void tone(uint8_t _pin, unsigned int frequency, unsigned long duration = 0) { throw "Not Yet Implemented"; }
 inline void noTone(uint8_t _pin) { throw "Not Yet Implemented"; }
-inline uint8_t pulseIn(uint8_t _pin, uint8_t _value, uint32_t _timeout) { throw "Not Yet Implemented"; }
-inline uint8_t pulseIn(uint8_t pin, uint8_t value) { return pulseIn(pin, value, (uint32_t) 1000000); }
-inline uint32_t pulseInLong(uint8_t _pin, uint8_t _value, uint32_t _timeout) { throw "Not Yet Implemented"; }
-inline uint32_t pulseInLong(uint8_t pin, uint8_t value) { return pulseInLong(pin, value, (uint32_t) 1000000); }
+
+// pulse length in microseconds, measured against the pin's input timeline (see PinHistory::setInputAt).
+// waits out a pulse already in progress, as the hardware does.  0 if no whole pulse starts and ends
+// within the timeout.  the clock is left at the end of the pulse (or the timeout)
+unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
+unsigned long pulseInLong(uint8_t pin, uint8_t state, unsigned long timeout = 1000000L);
 
 /**
  * Shifts in a byte of data one bit at a time.
@@ -249,4 +463,7 @@ inline void shiftOut(uint8_t dataPin, uint8_t clockPin, bool bitOrder, uint8_t v
 #endif
 
 
-GodmodeState* GODMODE();
+// the state of the current thread's mocked world
+inline GodmodeState* GODMODE() {
+  return GodmodeState::getInstance();
+}
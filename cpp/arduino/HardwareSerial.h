@@ -32,7 +32,7 @@
 class HardwareSerial : public StreamTape
 {
   public:
-    HardwareSerial(String* dataIn, String* dataOut, unsigned long* delay): StreamTape(dataIn, dataOut, delay) {}
+    HardwareSerial(ArduinoCIStreamInput dataIn, String* dataOut, unsigned long* delay): StreamTape(dataIn, dataOut, delay) {}
 
     void begin(unsigned long baud) { begin(baud, SERIAL_8N1); }
     void begin(unsigned long baud, uint8_t config) {
@@ -45,19 +45,19 @@ class HardwareSerial : public StreamTape
 };
 
 #if NUM_SERIAL_PORTS >= 1
-  extern HardwareSerial Serial;
+  extern thread_local HardwareSerial Serial;
   #define HAVE_HWSERIAL0
 #endif
 #if NUM_SERIAL_PORTS >= 2
-  extern HardwareSerial Serial1;
+  extern thread_local HardwareSerial Serial1;
   #define HAVE_HWSERIAL1
 #endif
 #if NUM_SERIAL_PORTS >= 3
-  extern HardwareSerial Serial2;
+  extern thread_local HardwareSerial Serial2;
   #define HAVE_HWSERIAL2
 #endif
 #if NUM_SERIAL_PORTS >= 4
-  extern HardwareSerial Serial3;
+  extern thread_local HardwareSerial Serial3;
   #define HAVE_HWSERIAL3
 #endif
 
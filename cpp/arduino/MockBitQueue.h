@@ -0,0 +1,181 @@
+#pragma once
+#include <stdint.h>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+#include "WString.h"
+
+// A queue of bits, packed 64 to a word.
+//
+// This stands in for a queue of bool events where timestamps are not needed, namely the
+// queued input of a digital pin; MockEventQueue<bool> keeps its bits in one of these too.
+// Bulk serial-style decoding (toAscii) and comparison (hasBits) work on whole words
+// instead of one bit at a time.
+class MockBitQueue {
+  public:
+    // the same as MockEventQueue<bool>::Event
+    struct Event {
+      bool data;
+      unsigned long micros;
+
+      Event() : data(false), micros(0) {}
+      Event(const bool &d, unsigned long const t) : data(d), micros(t) { }
+    };
+
+  private:
+    std::vector<uint64_t> mWords;  // bit n lives at mWords[n / 64], position n % 64
+    unsigned long mHead;           // absolute position of the oldest bit
+    unsigned long mTail;           // absolute position after the newest bit
+
+    // consumed words are dropped once there are at least this many bits of them,
+    // and at least as many as remain queued (so compaction is amortized O(1))
+    static const unsigned long COMPACT_BITS = 4096;
+
+    inline bool bitAt(unsigned long pos) const { return (mWords[pos >> 6] >> (pos & 63)) & 0x1; }
+
+    // the 64 bits starting at an absolute position, first bit in the least significant place.
+    // bits past the end of the queue read as zero.
+    uint64_t window(unsigned long pos) const {
+      unsigned long w = pos >> 6;
+      unsigned int s = pos & 63;
+      uint64_t ret = mWords[w] >> s;
+      if (s && w + 1 < mWords.size()) ret |= mWords[w + 1] << (64 - s);
+      return ret;
+    }
+
+    // reverse the order of the bits within each byte of a word
+    static uint64_t reverseBitsInBytes(uint64_t v) {
+      v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+      v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+      v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+      return v;
+    }
+
+    void compact() {
+      unsigned long drop = mHead >> 6;
+      mWords.erase(mWords.begin(), mWords.begin() + drop);
+      mHead -= drop << 6;
+      mTail -= drop << 6;
+    }
+
+  public:
+    // what operator-> of an iterator over packed events returns: the event, held by value
+    class EventArrow {
+      private:
+        Event mEvent;
+
+      public:
+        EventArrow(const Event& e) : mEvent(e) { }
+        const Event* operator->() const { return &mEvent; }
+    };
+
+    // read-only traversal of the queued bits, oldest first.  there is no stored event to refer
+    // to, so dereferencing gives one by value.  events carry a timestamp of 0 since none is stored.
+    class const_iterator {
+      private:
+        const MockBitQueue* mQueue;
+        unsigned long mPos;
+
+      public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef Event value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef EventArrow pointer;
+        typedef Event reference;
+
+        const_iterator() : mQueue(nullptr), mPos(0) { }
+        const_iterator(const MockBitQueue* q, unsigned long pos) : mQueue(q), mPos(pos) { }
+
+        reference operator*() const { return Event(mQueue->bitAt(mPos), 0); }
+        pointer operator->() const { return EventArrow(**this); }
+
+        const_iterator& operator++() { ++mPos; return *this; }
+        const_iterator operator++(int) { const_iterator ret = *this; ++mPos; return ret; }
+        const_iterator& operator--() { --mPos; return *this; }
+        const_iterator operator--(int) { const_iterator ret = *this; --mPos; return ret; }
+
+        bool operator==(const const_iterator& rhs) const { return mPos == rhs.mPos; }
+        bool operator!=(const const_iterator& rhs) const { return mPos != rhs.mPos; }
+    };
+
+    typedef const_iterator iterator;
+
+    MockBitQueue() : mHead(0), mTail(0) { }
+
+    inline unsigned long size() const { return mTail - mHead; }
+    inline bool empty() const { return mTail == mHead; }
+    inline bool frontData() const { return empty() ? false : bitAt(mHead); }
+    inline bool backData() const { return empty() ? false : bitAt(mTail - 1); }
+    inline Event front() const { return Event(frontData(), 0); }
+    inline Event back() const { return Event(backData(), 0); }
+    inline unsigned long frontTime() const { return 0; }
+    inline unsigned long backTime() const { return 0; }
+
+    const_iterator begin() const { return const_iterator(this, mHead); }
+    const_iterator end() const { return const_iterator(this, mTail); }
+
+    // the bit at a position from the front.  pos must be less than size()
+    inline bool at(unsigned long pos) const { return bitAt(mHead + pos); }
+
+    bool push(bool v) {
+      if ((mTail >> 6) >= mWords.size()) mWords.push_back(0);
+      if (v) mWords[mTail >> 6] |= (uint64_t)1 << (mTail & 63);
+      ++mTail;
+      return true;
+    }
+
+    void pop() {
+      if (empty()) return;
+      if (++mHead == mTail) {
+        clear();
+      } else if (mHead >= COMPACT_BITS && mHead >= size()) {
+        compact();
+      }
+    }
+
+    void clear() {
+      mWords.clear();
+      mHead = mTail = 0;
+    }
+
+    // decode one serial byte starting offset bits in, or -1 if there aren't 8 bits there
+    int byteAt(unsigned long offset, bool bigEndian) const {
+      if (size() < offset + 8) return -1;
+      uint64_t v = window(mHead + offset) & 0xFF;
+      if (bigEndian) v = reverseBitsInBytes(v);
+      return (int)v;
+    }
+
+    // whether the queue starts with exactly the given bits, compared 64 at a time
+    bool hasBits(const bool* arr, unsigned long length) const {
+      if (length > size()) return false;
+      unsigned long pos = mHead;
+      for (unsigned long i = 0; i < length; i += 64, pos += 64) {
+        unsigned long n = length - i < 64 ? length - i : 64;
+        uint64_t expected = 0;
+        for (unsigned long k = 0; k < n; ++k) expected |= (uint64_t)(arr[i + k] ? 1 : 0) << k;
+        uint64_t actual = window(pos);
+        if (n < 64) actual &= ((uint64_t)1 << n) - 1;
+        if (actual != expected) return false;
+      }
+      return true;
+    }
+
+    // decode the bits as serial bytes, starting from offset bits in, considering endianness.
+    // trailing bits that don't make a whole byte are ignored.
+    String toAscii(unsigned long offset, bool bigEndian) const {
+      String ret = "";
+      if (size() <= offset) return ret;
+
+      unsigned long numBytes = (size() - offset) / 8;
+      ret.resize(numBytes);
+      unsigned long pos = mHead + offset;
+      for (unsigned long i = 0; i < numBytes; i += 8, pos += 64) {
+        uint64_t v = window(pos);
+        if (bigEndian) v = reverseBitsInBytes(v);
+        unsigned long n = numBytes - i < 8 ? numBytes - i : 8;
+        for (unsigned long k = 0; k < n; ++k) ret[i + k] = (char)(v >> (8 * k));
+      }
+      return ret;
+    }
+};
@@ -1,4 +1,9 @@
 #pragma once
+#include <cstddef>
+#include <iterator>
+#include <stdint.h>
+#include <vector>
+#include "MockBitQueue.h"
 
 template <typename T>
 class MockEventQueue {
@@ -12,51 +17,217 @@ class MockEventQueue {
     };
 
   private:
-    struct Node {
-      Event event;
-      Node* next;
+    // events are stored contiguously in fixed-size chunks, so that push and pop
+    // only touch the allocator once per chunk instead of once per event.
+    static const unsigned int CHUNK_SIZE = 64;
 
-      Node(const Event &e, Node* n) : event(e), next(n) { }
+    // emptied chunks are kept on a per-queue free list, up to this many
+    static const unsigned int MAX_FREE_CHUNKS = 4;
+
+    struct Chunk {
+      Event events[CHUNK_SIZE];
+      Chunk* next;
+
+      Chunk() : next(nullptr) { }
     };
 
-    Node* mFront;
-    Node* mBack;
+    Chunk* mFront;             // chunk holding the oldest event
+    Chunk* mBack;              // chunk holding the newest event
+    Chunk* mFree;              // recycled chunks
+    std::vector<Chunk*> mIndex; // chunks in order, for random access; mFront is at mIndexHead
+    unsigned long mIndexHead;
+    unsigned int mFrontIdx;    // position of the oldest event in mFront
+    unsigned int mBackIdx;     // position after the newest event in mBack
+    unsigned int mFreeCount;
     unsigned long mSize;
     T mNil;
     unsigned long (*mGetMicros)(void);
 
     void init(unsigned long (*getMicros)(void)) {
-      mFront = mBack = nullptr;
+      mFront = mBack = mFree = nullptr;
+      mFrontIdx = mBackIdx = mFreeCount = 0;
+      mIndexHead = 0;
       mSize = 0;
       mGetMicros = getMicros;
     }
 
+    Chunk* acquireChunk() {
+      if (mFree == nullptr) return new Chunk();
+      Chunk* c = mFree;
+      mFree = c->next;
+      c->next = nullptr;
+      --mFreeCount;
+      return c;
+    }
+
+    void releaseChunk(Chunk* c) {
+      if (mFreeCount >= MAX_FREE_CHUNKS) {
+        delete c;
+        return;
+      }
+      c->next = mFree;
+      mFree = c;
+      ++mFreeCount;
+    }
+
   public:
+    // read-only forward traversal of the queue, oldest event first, without copying
+    class const_iterator {
+      private:
+        const Chunk* mChunk;
+        unsigned int mIdx;
+
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef Event value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const Event* pointer;
+        typedef const Event& reference;
+
+        const_iterator() : mChunk(nullptr), mIdx(0) { }
+        const_iterator(const Chunk* c, unsigned int idx) : mChunk(c), mIdx(idx) { }
+
+        reference operator*() const { return mChunk->events[mIdx]; }
+        pointer operator->() const { return &mChunk->events[mIdx]; }
+
+        const_iterator& operator++() {
+          // stay parked at the end of the last chunk so that we compare equal to end()
+          if (++mIdx == CHUNK_SIZE && mChunk->next) {
+            mChunk = mChunk->next;
+            mIdx = 0;
+          }
+          return *this;
+        }
+
+        const_iterator operator++(int) {
+          const_iterator ret = *this;
+          ++(*this);
+          return ret;
+        }
+
+        bool operator==(const const_iterator& rhs) const { return mChunk == rhs.mChunk && mIdx == rhs.mIdx; }
+        bool operator!=(const const_iterator& rhs) const { return !(*this == rhs); }
+    };
+
+    typedef const_iterator iterator;
+
+    // a contiguous run of events, usable with range-based for
+    class const_range {
+      private:
+        const_iterator mBegin;
+        const_iterator mEnd;
+        unsigned long mSize;
+
+      public:
+        const_range(const_iterator b, const_iterator e, unsigned long n) : mBegin(b), mEnd(e), mSize(n) { }
+
+        const_iterator begin() const { return mBegin; }
+        const_iterator end() const { return mEnd; }
+        unsigned long size() const { return mSize; }
+        bool empty() const { return 0 == mSize; }
+    };
+
     MockEventQueue(unsigned long (*getMicros)(void)): mNil() { init(getMicros); }
     MockEventQueue(): mNil() { init(nullptr); }
 
-    MockEventQueue(const MockEventQueue<T>& q) {
+    MockEventQueue(const MockEventQueue<T>& q) : mNil() {
       init(q.mGetMicros);
-      for (Node* n = q.mFront; n; n = n->next) push(n->event);
+      for (const_iterator it = q.begin(); it != q.end(); ++it) push(*it);
+    }
+
+    MockEventQueue<T>& operator=(const MockEventQueue<T>& q) {
+      if (this == &q) return *this;
+      clear();
+      mGetMicros = q.mGetMicros;
+      for (const_iterator it = q.begin(); it != q.end(); ++it) push(*it);
+      return *this;
     }
 
     void setMicrosRetriever(unsigned long (*getMicros)(void)) { mGetMicros = getMicros; }
 
+    // the time that push(v) would stamp an event with
+    inline unsigned long currentMicros() const { return mGetMicros == nullptr ? 0 : mGetMicros(); }
+
     inline unsigned long size() const { return mSize; }
     inline bool empty() const { return 0 == mSize; }
-    inline Event front() const { return empty() ? Event(mNil, 0) : mFront->event; }
-    inline Event back() const { return empty() ?  Event(mNil, 0) : mBack->event; }
+    inline Event front() const { return empty() ? Event(mNil, 0) : mFront->events[mFrontIdx]; }
+    inline Event back() const { return empty() ?  Event(mNil, 0) : mBack->events[mBackIdx - 1]; }
     inline T frontData() const { return front().data; }
     inline T backData() const { return back().data; }
     inline unsigned long frontTime() const { return front().micros; }
     inline unsigned long backTime() const { return back().micros; }
 
+    const_iterator begin() const { return const_iterator(mFront, mFrontIdx); }
+    const_iterator end() const { return const_iterator(mBack, mBackIdx); }
+
+    // random access to the event at a position from the front, in O(1).  pos must be less than size()
+    const Event& at(unsigned long pos) const {
+      unsigned long abs = mFrontIdx + pos;
+      return mIndex[mIndexHead + abs / CHUNK_SIZE]->events[abs % CHUNK_SIZE];
+    }
+
+    // an iterator positioned at a given event; size() gives end()
+    const_iterator iteratorAt(unsigned long pos) const {
+      if (pos >= mSize) return end();
+      unsigned long abs = mFrontIdx + pos;
+      return const_iterator(mIndex[mIndexHead + abs / CHUNK_SIZE], abs % CHUNK_SIZE);
+    }
+
+    // the events from one position up to (but not including) another
+    const_range range(unsigned long from, unsigned long to) const {
+      if (to > mSize) to = mSize;
+      if (from > to) from = to;
+      return const_range(iteratorAt(from), iteratorAt(to), to - from);
+    }
+
+    // position of the first event stamped later than the given time, by binary search.
+    // assumes timestamps never decrease, which holds for events pushed against a clock.
+    unsigned long upperBound(unsigned long micros) const {
+      unsigned long lo = 0;
+      unsigned long hi = mSize;
+      while (lo < hi) {
+        unsigned long mid = lo + (hi - lo) / 2;
+        if (at(mid).micros <= micros) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      return lo;
+    }
+
+    // position of the first event stamped at or after the given time, by binary search
+    unsigned long lowerBound(unsigned long micros) const {
+      unsigned long lo = 0;
+      unsigned long hi = mSize;
+      while (lo < hi) {
+        unsigned long mid = lo + (hi - lo) / 2;
+        if (at(mid).micros < micros) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      return lo;
+    }
+
 
     // fully formed event
     bool push(const Event& e) {
-      Node *n = new Node(e, nullptr);
-      if (n == nullptr) return false;
-      mBack = (mFront == nullptr ? mFront : mBack->next) = n;
+      if (mBack == nullptr) {
+        Chunk* c = acquireChunk();
+        if (c == nullptr) return false;
+        mFront = mBack = c;
+        mFrontIdx = mBackIdx = 0;
+        mIndex.push_back(c);
+      } else if (mBackIdx == CHUNK_SIZE) {
+        Chunk* c = acquireChunk();
+        if (c == nullptr) return false;
+        mBack = mBack->next = c;
+        mBackIdx = 0;
+        mIndex.push_back(c);
+      }
+      mBack->events[mBackIdx++] = e;
       return ++mSize;
     }
 
@@ -68,19 +239,264 @@ class MockEventQueue {
 
     // event needing timestamp
     bool push(const T& v) {
-      unsigned long micros = mGetMicros == nullptr ? 0 : mGetMicros();
-      return push(v, micros);
+      return push(v, currentMicros());
+    }
+
+    void pop() {
+      if (empty()) return;
+      ++mFrontIdx;
+      if (--mSize == 0) {
+        // keep the one chunk we have and start over at its beginning
+        mFrontIdx = mBackIdx = 0;
+        return;
+      }
+      if (mFrontIdx == CHUNK_SIZE) {
+        Chunk* c = mFront;
+        mFront = mFront->next;
+        mFrontIdx = 0;
+        releaseChunk(c);
+        // drop stale index entries once they outnumber the live ones
+        ++mIndexHead;
+        if (mIndexHead >= mIndex.size() - mIndexHead) {
+          mIndex.erase(mIndex.begin(), mIndex.begin() + mIndexHead);
+          mIndexHead = 0;
+        }
+      }
+    }
+
+    void clear() {
+      if (mFront == nullptr) return;
+      Chunk* c = mFront->next;
+      while (c) {
+        Chunk* n = c->next;
+        releaseChunk(c);
+        c = n;
+      }
+      mFront->next = nullptr;
+      mBack = mFront;
+      mFrontIdx = mBackIdx = 0;
+      mSize = 0;
+      mIndex.assign(1, mFront);
+      mIndexHead = 0;
+    }
+
+    ~MockEventQueue() {
+      clear();
+      delete mFront;
+      while (mFree) {
+        Chunk* n = mFree->next;
+        delete mFree;
+        mFree = n;
+      }
+    }
+};
+
+// A digital pin's history: the same queue, packed.
+//
+// Values go in a MockBitQueue, 64 to a word, and timestamps are delta-encoded: each run of 64
+// events keeps the first one's time in full and the rest as 32-bit offsets from it.  That is
+// under 5 bytes an event instead of 16, and toAscii(), byteAt() and hasBits() decode or compare
+// whole words.  A run whose times don't fit offsets (a gap over 71 minutes, or a clock that went
+// backwards) keeps them in full instead.  Events are not stored as such, so at() and the
+// iterators give them by value.
+template <>
+class MockEventQueue<bool> {
+  public:
+    typedef MockBitQueue::Event Event;
+
+  private:
+    static const unsigned int BLOCK_SIZE = 64;
+
+    // drop consumed blocks once there are at least this many events in them
+    static const unsigned long COMPACT_AFTER = 4096;
+
+    struct TimeBlock {
+      unsigned long base;
+      uint32_t offsets[BLOCK_SIZE];
+      std::vector<unsigned long> full;  // used instead of base and offsets once one doesn't fit
+
+      inline unsigned long at(unsigned int i) const { return full.empty() ? base + offsets[i] : full[i]; }
+    };
+
+    MockBitQueue mBits;
+    std::vector<TimeBlock> mTimes;
+    unsigned long mTimeHead;  // slot of the oldest event's time, counting from mTimes[0]
+    unsigned long (*mGetMicros)(void);
+
+    inline unsigned long timeAt(unsigned long pos) const {
+      unsigned long slot = mTimeHead + pos;
+      return mTimes[slot / BLOCK_SIZE].at(slot % BLOCK_SIZE);
+    }
+
+    void pushTime(unsigned long micros) {
+      unsigned long slot = mTimeHead + size();
+      unsigned int i = slot % BLOCK_SIZE;
+      if (i == 0) {
+        mTimes.push_back(TimeBlock());
+        mTimes.back().base = micros;
+        mTimes.back().offsets[0] = 0;
+        return;
+      }
+      TimeBlock& b = mTimes[slot / BLOCK_SIZE];
+      if (b.full.empty() && micros >= b.base && micros - b.base <= 0xFFFFFFFFUL) {
+        b.offsets[i] = (uint32_t)(micros - b.base);
+        return;
+      }
+      if (b.full.empty()) {
+        b.full.resize(BLOCK_SIZE);
+        for (unsigned int k = 0; k < i; ++k) b.full[k] = b.base + b.offsets[k];
+      }
+      b.full[i] = micros;
+    }
+
+  public:
+    // read-only traversal of the queue, oldest event first.  events are decoded on the fly, so
+    // dereferencing gives one by value
+    class const_iterator {
+      private:
+        const MockEventQueue<bool>* mQueue;
+        unsigned long mPos;
+
+      public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef Event value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef MockBitQueue::EventArrow pointer;
+        typedef Event reference;
+
+        const_iterator() : mQueue(nullptr), mPos(0) { }
+        const_iterator(const MockEventQueue<bool>* q, unsigned long pos) : mQueue(q), mPos(pos) { }
+
+        reference operator*() const { return mQueue->at(mPos); }
+        pointer operator->() const { return pointer(**this); }
+
+        const_iterator& operator++() { ++mPos; return *this; }
+        const_iterator operator++(int) { const_iterator ret = *this; ++mPos; return ret; }
+        const_iterator& operator--() { --mPos; return *this; }
+        const_iterator operator--(int) { const_iterator ret = *this; --mPos; return ret; }
+
+        bool operator==(const const_iterator& rhs) const { return mQueue == rhs.mQueue && mPos == rhs.mPos; }
+        bool operator!=(const const_iterator& rhs) const { return !(*this == rhs); }
+    };
+
+    typedef const_iterator iterator;
+
+    // a contiguous run of events, usable with range-based for
+    class const_range {
+      private:
+        const_iterator mBegin;
+        const_iterator mEnd;
+        unsigned long mSize;
+
+      public:
+        const_range(const_iterator b, const_iterator e, unsigned long n) : mBegin(b), mEnd(e), mSize(n) { }
+
+        const_iterator begin() const { return mBegin; }
+        const_iterator end() const { return mEnd; }
+        unsigned long size() const { return mSize; }
+        bool empty() const { return 0 == mSize; }
+    };
+
+    MockEventQueue(unsigned long (*getMicros)(void)) : mBits(), mTimes(), mTimeHead(0), mGetMicros(getMicros) { }
+    MockEventQueue() : mBits(), mTimes(), mTimeHead(0), mGetMicros(nullptr) { }
+
+    void setMicrosRetriever(unsigned long (*getMicros)(void)) { mGetMicros = getMicros; }
+
+    // the time that push(v) would stamp an event with
+    inline unsigned long currentMicros() const { return mGetMicros == nullptr ? 0 : mGetMicros(); }
+
+    inline unsigned long size() const { return mBits.size(); }
+    inline bool empty() const { return mBits.empty(); }
+    inline Event front() const { return empty() ? Event() : at(0); }
+    inline Event back() const { return empty() ? Event() : at(size() - 1); }
+    inline bool frontData() const { return front().data; }
+    inline bool backData() const { return back().data; }
+    inline unsigned long frontTime() const { return front().micros; }
+    inline unsigned long backTime() const { return back().micros; }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+
+    // the event at a position from the front, in O(1).  pos must be less than size()
+    Event at(unsigned long pos) const { return Event(mBits.at(pos), timeAt(pos)); }
+
+    // an iterator positioned at a given event; size() gives end()
+    const_iterator iteratorAt(unsigned long pos) const { return const_iterator(this, pos < size() ? pos : size()); }
+
+    // the events from one position up to (but not including) another
+    const_range range(unsigned long from, unsigned long to) const {
+      if (to > size()) to = size();
+      if (from > to) from = to;
+      return const_range(iteratorAt(from), iteratorAt(to), to - from);
+    }
+
+    // position of the first event stamped later than the given time, by binary search.
+    // assumes timestamps never decrease, which holds for events pushed against a clock.
+    unsigned long upperBound(unsigned long micros) const {
+      unsigned long lo = 0;
+      unsigned long hi = size();
+      while (lo < hi) {
+        unsigned long mid = lo + (hi - lo) / 2;
+        if (timeAt(mid) <= micros) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      return lo;
     }
 
+    // position of the first event stamped at or after the given time, by binary search
+    unsigned long lowerBound(unsigned long micros) const {
+      unsigned long lo = 0;
+      unsigned long hi = size();
+      while (lo < hi) {
+        unsigned long mid = lo + (hi - lo) / 2;
+        if (timeAt(mid) < micros) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      return lo;
+    }
+
+    // fully formed event
+    bool push(const Event& e) {
+      pushTime(e.micros);
+      return mBits.push(e.data);
+    }
+
+    // fully specified event
+    bool push(const bool& v, unsigned long const time) { return push(Event(v, time)); }
+
+    // event needing timestamp
+    bool push(const bool& v) { return push(v, currentMicros()); }
+
     void pop() {
       if (empty()) return;
-      Node* n = mFront;
-      mFront = mFront->next;
-      delete n;
-      if (--mSize == 0) mBack = nullptr;
+      mBits.pop();
+      if (mBits.empty()) {
+        clear();
+        return;
+      }
+      if (++mTimeHead >= COMPACT_AFTER && mTimeHead >= size()) {
+        unsigned long drop = mTimeHead / BLOCK_SIZE;
+        mTimes.erase(mTimes.begin(), mTimes.begin() + drop);
+        mTimeHead -= drop * BLOCK_SIZE;
+      }
+    }
+
+    void clear() {
+      mBits.clear();
+      mTimes.clear();
+      mTimeHead = 0;
     }
 
-    void clear() { while (!empty()) pop(); }
+    // the values as serial bytes, a word at a time; see MockBitQueue
+    inline String toAscii(unsigned long offset, bool bigEndian) const { return mBits.toAscii(offset, bigEndian); }
+    inline int byteAt(unsigned long offset, bool bigEndian) const { return mBits.byteAt(offset, bigEndian); }
 
-    ~MockEventQueue() { clear(); }
+    // whether the values start with exactly the given ones, compared a word at a time
+    inline bool hasBits(const bool* arr, unsigned long length) const { return mBits.hasBits(arr, length); }
 };
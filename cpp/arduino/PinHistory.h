@@ -1,29 +1,178 @@
 #pragma once
+#include <limits.h>
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
 #include "MockEventQueue.h"
+#include "MockBitQueue.h"
 #include "ci/ObservableDataStream.h"
 #include "WString.h"
 
+// How much of a pin's output history is retained.
+enum PinHistoryStorage {
+  PIN_HISTORY_FULL,         // every value written to the pin (default)
+  PIN_HISTORY_TRANSITIONS,  // only writes that change the value; repeated writes are collapsed into the first
+  PIN_HISTORY_RING,         // the most recent N values, where N is the storage capacity
+  PIN_HISTORY_CURRENT       // only the latest value
+};
+
+// the storage policy that pins start with can be chosen at compile time
+#if !defined(PIN_HISTORY_DEFAULT_STORAGE)
+  #define PIN_HISTORY_DEFAULT_STORAGE PIN_HISTORY_FULL
+#endif
+
+// the ring size used by PIN_HISTORY_RING when none is given
+#if !defined(PIN_HISTORY_DEFAULT_CAPACITY)
+  #define PIN_HISTORY_DEFAULT_CAPACITY 1024
+#endif
+
+// queued input carries no timestamps, so digital pins can keep it bit-packed
+template <typename T> struct PinInputQueue { typedef MockEventQueue<T> type; };
+template <> struct PinInputQueue<bool> { typedef MockBitQueue type; };
+
 // pins with history.
 template <typename T>
 class PinHistory : public ObservableDataStream {
   private:
-    MockEventQueue<T> qIn;
+    typename PinInputQueue<T>::type qIn;
     MockEventQueue<T> qOut;
+    mutable MockEventQueue<T> qTimeline;  // input scheduled by time; see setInputAt()
+    mutable bool mTimelineUnsorted;       // whether events were added out of order since the last query
+    mutable unsigned long mTimelinePos;   // position in qTimeline of the value seen by the last read
+    mutable std::vector<unsigned long> mTimelineChanges;  // positions in qTimeline whose value differs from the one before
+    mutable bool mTimelineChangesStale;                   // whether mTimelineChanges needs rebuilding
+    std::function<T(unsigned long)> mGenerator;  // input as a function of time; see setGenerator()
+    std::function<bool(unsigned long, unsigned long&)> mGeneratorNextChange;  // where the generator can say
+    PinHistoryStorage mStorage;
+    unsigned long mCapacity;
+    void (*mOnChange)(unsigned int tag, T before, T after);
+    unsigned int mOnChangeTag;
+
+    // set a new value of the pin, and tell the change handler if there is one
+    void record(const T& val) {
+      T before = qOut.backData();
+      store(val);
+      if (mOnChange) mOnChange(mOnChangeTag, before, val);
+    }
+
+    // add a value to the output history according to the storage policy
+    void store(const T& val) {
+      switch (mStorage) {
+        case PIN_HISTORY_TRANSITIONS:
+          if (!qOut.empty() && qOut.backData() == val) return;  // same value, keep the original timestamp
+          qOut.push(val);
+          return;
+        case PIN_HISTORY_RING:
+          qOut.push(val);
+          while (qOut.size() > mCapacity) qOut.pop();
+          return;
+        case PIN_HISTORY_CURRENT:
+          qOut.pop();
+          qOut.push(val);
+          return;
+        default:
+          qOut.push(val);
+      }
+    }
+
+    // shrink existing history to fit the storage policy
+    void enforceStorage() {
+      switch (mStorage) {
+        case PIN_HISTORY_RING:
+          while (qOut.size() > mCapacity) qOut.pop();
+          return;
+        case PIN_HISTORY_CURRENT:
+          while (qOut.size() > 1) qOut.pop();
+          return;
+        case PIN_HISTORY_TRANSITIONS: {
+          MockEventQueue<T> collapsed(qOut);
+          qOut.clear();
+          for (typename MockEventQueue<T>::const_iterator it = collapsed.begin(); it != collapsed.end(); ++it) {
+            if (qOut.empty() || qOut.backData() != it->data) qOut.push(*it);
+          }
+          return;
+        }
+        default:
+          return;
+      }
+    }
 
     void clear() {
       qOut.clear();
       qIn.clear();
+      qTimeline.clear();
+      mTimelineUnsorted = false;
+      mTimelinePos = 0;
+      mTimelineChanges.clear();
+      mTimelineChangesStale = false;
+      mGenerator = nullptr;
+      mGeneratorNextChange = nullptr;
+    }
+
+    static bool earlier(const typename MockEventQueue<T>::Event& a, const typename MockEventQueue<T>::Event& b) {
+      return a.micros < b.micros;
     }
 
-    // enqueue ascii bits
-    void a2q(MockEventQueue<T> &q, String input, bool bigEndian, bool advertise) {
+    // put the timeline in order if anything was added out of order, in one O(n log n) pass.
+    // of events for the same time, the one added last wins
+    void sortTimeline() const {
+      if (!mTimelineUnsorted) return;
+      std::vector<typename MockEventQueue<T>::Event> events(qTimeline.begin(), qTimeline.end());
+      std::stable_sort(events.begin(), events.end(), earlier);
+      qTimeline.clear();
+      for (unsigned long i = 0; i < events.size(); ++i) {
+        if (i + 1 < events.size() && events[i + 1].micros == events[i].micros) continue;
+        qTimeline.push(events[i]);
+      }
+      mTimelineUnsorted = false;
+      mTimelinePos = 0;
+      mTimelineChangesStale = true;
+    }
+
+    // the positions at which the timeline changes value, the first always among them
+    const std::vector<unsigned long>& timelineChanges() const {
+      sortTimeline();
+      if (mTimelineChangesStale) {
+        mTimelineChanges.clear();
+        for (unsigned long pos = 0; pos < qTimeline.size(); ++pos) {
+          if (pos == 0 || qTimeline.at(pos).data != qTimeline.at(pos - 1).data) mTimelineChanges.push_back(pos);
+        }
+        mTimelineChangesStale = false;
+      }
+      return mTimelineChanges;
+    }
+
+    // position of the timeline event in effect at a time, which must be no earlier than the first.
+    // reads usually come a little later than the one before, so walk forward from there a few
+    // steps before falling back to a binary search: amortized O(1) for a sketch polling a trace
+    unsigned long timelinePosAt(unsigned long micros) {
+      sortTimeline();
+      unsigned long pos = mTimelinePos;
+      unsigned long n = qTimeline.size();
+      if (pos < n && qTimeline.at(pos).micros <= micros) {
+        for (int steps = 0; steps < 8; ++steps) {
+          if (pos + 1 >= n || qTimeline.at(pos + 1).micros > micros) return mTimelinePos = pos;
+          ++pos;
+        }
+      }
+      return mTimelinePos = qTimeline.upperBound(micros) - 1;
+    }
+
+    // enqueue ascii bits, either as future input or immediately as output
+    void a2q(String input, bool bigEndian, bool output) {
       // 8 chars at a time, form up
       for (int j = 0; j < input.length(); ++j) {
         for (int i = 0; i < 8; ++i) {
           int shift = bigEndian ? 7 - i : i;
           unsigned char mask = (0x01 << shift);
-          q.push(mask & input[j]);
-          if (advertise) advertiseBit(q.backData()); // not valid for all possible types but whatever
+          T val = mask & input[j];
+          if (!output) {
+            qIn.push(val);
+            continue;
+          }
+          record(val);
+          advertiseBit(val); // not valid for all possible types but whatever
         }
       }
     }
@@ -31,37 +180,128 @@ class PinHistory : public ObservableDataStream {
 
     // convert a queue to a string as if it was serial bits
     // start from offset, consider endianness
-    String q2a(const MockEventQueue<T> &q, unsigned int offset, bool bigEndian) const {
+    template <typename Q>
+    String q2a(const Q &q, unsigned int offset, bool bigEndian) const {
       String ret = "";
+      if (q.size() <= offset) return ret;
 
-      MockEventQueue<T> q2(q);
-
-      while (offset) {
-        q2.pop();
-        --offset;
-      }
-
-      if (offset) return ret;
+      typename Q::const_iterator it = q.begin();
+      for (unsigned int i = 0; i < offset; ++i) ++it;
 
       // 8 chars at a time, form up
-      while (q2.size() >= 8) {
+      for (unsigned long remaining = q.size() - offset; remaining >= 8; remaining -= 8) {
         unsigned char acc = 0x00;
-        for (int i = 0; i < 8; ++i) {
+        for (int i = 0; i < 8; ++i, ++it) {
           int shift = bigEndian ? 7 - i : i;
-          T val = q2.frontData();
-          unsigned char bit = val ? 0x1 : 0x0;
+          unsigned char bit = it->data ? 0x1 : 0x0;
           acc |= (bit << shift);
-          q2.pop();
         }
-        ret.append(String((char)acc));
+        ret.append(1, (char)acc);
       }
 
       return ret;
     }
 
+    // packed bits can be decoded a word at a time
+    String q2a(const MockBitQueue &q, unsigned int offset, bool bigEndian) const {
+      return q.toAscii(offset, bigEndian);
+    }
+
+    String q2a(const MockEventQueue<bool> &q, unsigned int offset, bool bigEndian) const {
+      return q.toAscii(offset, bigEndian);
+    }
+
+    // decode only the first byte of a queue as if it was serial bits, or -1 if there isn't one
+    template <typename Q>
+    int q2byte(const Q &q, unsigned int offset, bool bigEndian) const {
+      if (q.size() < offset + 8) return -1;
+
+      typename Q::const_iterator it = q.begin();
+      for (unsigned int i = 0; i < offset; ++i) ++it;
+
+      unsigned char acc = 0x00;
+      for (int i = 0; i < 8; ++i, ++it) {
+        int shift = bigEndian ? 7 - i : i;
+        unsigned char bit = it->data ? 0x1 : 0x0;
+        acc |= (bit << shift);
+      }
+      return acc;
+    }
+
+    int q2byte(const MockBitQueue &q, unsigned int offset, bool bigEndian) const {
+      return q.byteAt(offset, bigEndian);
+    }
+
+    // whether a queue starts with the given values
+    template <typename Q>
+    bool qHas(const Q &q, T const * const arr, unsigned int length) const {
+      unsigned int i = 0;
+      for (typename Q::const_iterator it = q.begin(); i < length && it != q.end(); ++it, ++i) {
+        if (it->data != arr[i]) return false;
+      }
+      return i == length;
+    }
+
+    // packed bits are compared a word at a time
+    bool qHas(const MockEventQueue<bool> &q, bool const * const arr, unsigned int length) const {
+      return q.hasBits(arr, length);
+    }
+
+    // count the transitions in one direction among events in [t0, t1).
+    // the first event in the window is compared to the event just before it.
+    unsigned long countEdges(bool rising, unsigned long t0, unsigned long t1) const {
+      unsigned long pos = qOut.lowerBound(t0);
+      if (pos == 0) {
+        if (qOut.empty()) return 0;
+        ++pos;  // the very first event has nothing to transition from
+      }
+      bool prev = (bool)qOut.at(pos - 1).data;
+      unsigned long ret = 0;
+      for (typename MockEventQueue<T>::const_iterator it = qOut.iteratorAt(pos); it != qOut.end() && it->micros < t1; ++it) {
+        bool cur = (bool)it->data;
+        if (cur != prev && cur == rising) ++ret;
+        prev = cur;
+      }
+      return ret;
+    }
+
+    // find the pulses at a given level that begin and end among events in [t0, t1)
+    void measurePulses(bool high, unsigned long t0, unsigned long t1, unsigned long &count, unsigned long &shortest, unsigned long &longest) const {
+      count = shortest = longest = 0;
+      unsigned long pos = qOut.lowerBound(t0);
+      if (pos == 0) {
+        if (qOut.empty()) return;
+        ++pos;  // the very first event has nothing to transition from
+      }
+      bool prev = (bool)qOut.at(pos - 1).data;
+      bool inPulse = false;
+      unsigned long start = 0;
+      for (typename MockEventQueue<T>::const_iterator it = qOut.iteratorAt(pos); it != qOut.end() && it->micros < t1; ++it) {
+        bool cur = (bool)it->data;
+        if (cur == prev) continue;
+        if (cur == high) {
+          inPulse = true;
+          start = it->micros;
+        } else if (inPulse) {
+          unsigned long width = it->micros - start;
+          if (count == 0 || width < shortest) shortest = width;
+          if (count == 0 || width > longest) longest = width;
+          ++count;
+        }
+        prev = cur;
+      }
+    }
+
     void init() {
       asciiEncodingOffsetIn = 0;  // default is sensible
       asciiEncodingOffsetOut = 1; // default is sensible
+      mStorage = PIN_HISTORY_DEFAULT_STORAGE;
+      mCapacity = PIN_HISTORY_DEFAULT_CAPACITY;
+      mOnChange = nullptr;
+      mOnChangeTag = 0;
+      mTimelineUnsorted = false;
+      mTimelinePos = 0;
+      mTimelineChangesStale = false;
     }
 
   public:
@@ -83,6 +323,30 @@ class PinHistory : public ObservableDataStream {
       qOut.push(val);
     }
 
+    // reset with an explicit timestamp for the initial value
+    void reset(T val, unsigned long micros) {
+      clear();
+      qOut.push(val, micros);
+    }
+
+    // choose how much output history this pin keeps.  capacity only applies to PIN_HISTORY_RING.
+    // existing history is trimmed to fit.  the policy survives reset().
+    void setStorage(PinHistoryStorage storage, unsigned long capacity = PIN_HISTORY_DEFAULT_CAPACITY) {
+      mStorage = storage;
+      mCapacity = capacity ? capacity : 1;
+      enforceStorage();
+    }
+
+    // call a function each time the pin takes a value, whether written or consumed from queued input.
+    // the tag is passed back to identify the pin.  nullptr removes it.  the handler survives reset().
+    void setChangeHandler(void (*onChange)(unsigned int tag, T before, T after), unsigned int tag) {
+      mOnChange = onChange;
+      mOnChangeTag = tag;
+    }
+
+    PinHistoryStorage storage() const { return mStorage; }
+    unsigned long storageCapacity() const { return mCapacity; }
+
     unsigned int historySize() const { return qOut.size(); }
 
     unsigned int queueSize() const { return qIn.size(); }
@@ -98,19 +362,31 @@ class PinHistory : public ObservableDataStream {
     // the actual "set" operation doesn't happen until the next read
     T operator=(const T& i) {
       qIn.clear();
-      qOut.push(i);
+      record(i);
       advertiseBit(qOut.backData()); // not valid for all possible types but whatever
       return qOut.backData();
     }
 
     // This returns the "value" of the pin according to the queued values
     // if there is input, advance it to the output.
+    // otherwise, if the input timeline has started, the input is whatever it says for the current time.
+    // otherwise, a generator gives the input for the current time.
     // then take the latest output.
     T retrieve() {
       if (!qIn.empty()) {
         T hack_required_by_travis_ci = qIn.frontData();
         qIn.pop();
-        qOut.push(hack_required_by_travis_ci);
+        record(hack_required_by_travis_ci);
+      } else if (!qTimeline.empty() || mGenerator) {
+        unsigned long now = qOut.currentMicros();
+        sortTimeline();
+        if (!qTimeline.empty() && qTimeline.frontTime() <= now) {
+          T val = qTimeline.at(timelinePosAt(now)).data;
+          if (qOut.empty() || qOut.backData() != val) record(val);
+        } else if (mGenerator) {
+          T val = mGenerator(now);
+          if (qOut.empty() || qOut.backData() != val) record(val);
+        }
       }
       return qOut.backData();
     }
@@ -121,10 +397,10 @@ class PinHistory : public ObservableDataStream {
     }
 
     // enqueue ascii bits for future use by the retrieve() function
-    void fromAscii(String input, bool bigEndian) { a2q(qIn, input, bigEndian, false); }
+    void fromAscii(String input, bool bigEndian) { a2q(input, bigEndian, false); }
 
     // send a stream of ascii bits immediately
-    void outgoingFromAscii(String input, bool bigEndian) { a2q(qOut, input, bigEndian, true); }
+    void outgoingFromAscii(String input, bool bigEndian) { a2q(input, bigEndian, true); }
 
     // convert the queue of incoming data to a string as if it was Serial comms
     // start from offset, consider endianness
@@ -134,6 +410,15 @@ class PinHistory : public ObservableDataStream {
     // start from offset, consider endianness
     String incomingToAscii(bool bigEndian) const { return incomingToAscii(asciiEncodingOffsetIn, bigEndian); }
 
+    // the number of whole bytes in the queue of incoming data, as if it was Serial comms
+    unsigned int incomingAsciiLength(unsigned int offset) const {
+      return qIn.size() > offset ? (qIn.size() - offset) / 8 : 0;
+    }
+
+    // the first byte of the queue of incoming data as if it was Serial comms, or -1 if none
+    // start from offset, consider endianness
+    int incomingAsciiFront(unsigned int offset, bool bigEndian) const { return q2byte(qIn, offset, bigEndian); }
+
     // convert the pin history data to a string as if it was Serial comms
     // start from offset, consider endianness
     String toAscii(unsigned int offset, bool bigEndian) const { return q2a(qOut, offset, bigEndian); }
@@ -142,16 +427,179 @@ class PinHistory : public ObservableDataStream {
     // start from offset, consider endianness
     String toAscii(bool bigEndian) const { return toAscii(asciiEncodingOffsetOut, bigEndian); }
 
+    // read-only view of the pin history (oldest first), suitable for range-based for
+    const MockEventQueue<T>& history() const { return qOut; }
+
+    // read-only view of the queued input (next value first)
+    const typename PinInputQueue<T>::type& incoming() const { return qIn; }
+
+    // iterate over the pin history events in place, oldest first
+    typename MockEventQueue<T>::const_iterator begin() const { return qOut.begin(); }
+    typename MockEventQueue<T>::const_iterator end() const { return qOut.end(); }
+
+    // Input timeline: values the pin's input takes at given times, as opposed to the queued
+    // input, which advances one value per read.  Once the clock reaches the first of them,
+    // digitalRead() and analogRead() see the value for the current time, however often they poll.
+    // Queued input, while there is any, still comes first.
+
+    // schedule the input to take a value at a given time, replacing any value already set for
+    // that time.  each call is O(1); values given out of order are sorted once, when next needed
+    void setInputAt(unsigned long micros, T value) {
+      typename MockEventQueue<T>::Event e(value, micros);
+      if (!mTimelineUnsorted && (qTimeline.empty() || qTimeline.backTime() < micros)) {
+        if (!mTimelineChangesStale && (qTimeline.empty() || qTimeline.backData() != value)) {
+          mTimelineChanges.push_back(qTimeline.size());
+        }
+      } else {
+        mTimelineUnsorted = true;
+        mTimelineChangesStale = true;
+      }
+      qTimeline.push(e);
+    }
+
+    // schedule many values at once, each at its own time
+    void setInputAt(const unsigned long* times, const T* values, unsigned long count) {
+      for (unsigned long i = 0; i < count; ++i) setInputAt(times[i], values[i]);
+    }
+
+    // schedule samples taken at a fixed interval, the first at a given time
+    void setInputEvery(unsigned long start, unsigned long interval, const T* values, unsigned long count) {
+      for (unsigned long i = 0; i < count; ++i) setInputAt(start + i * interval, values[i]);
+    }
+
+    // drive the input from a function of time (such as those in ci/Signals.h), evaluated
+    // whenever the pin is read.  it comes after queued input and a started timeline.
+    // nullptr removes it, as does reset()
+    void setGenerator(const std::function<T(unsigned long)>& generator) {
+      mGenerator = generator;
+      mGeneratorNextChange = nullptr;
+    }
+
+    // a generator that can also say when it next changes, with
+    // `bool nextChange(unsigned long after, unsigned long& at) const` (as the square waves in
+    // ci/Signals.h can), lets nextInputAt() and pulseIn() go from edge to edge instead of sampling
+    template <typename G>
+    auto setGenerator(const G& generator) -> decltype(generator.nextChange(0UL, std::declval<unsigned long&>()), void()) {
+      mGenerator = generator;
+      mGeneratorNextChange = [generator](unsigned long after, unsigned long& at) { return generator.nextChange(after, at); };
+    }
+
+    bool hasGenerator() const { return (bool)mGenerator; }
+
+    // read-only view of the input timeline
+    const MockEventQueue<T>& timeline() const {
+      sortTimeline();
+      return qTimeline;
+    }
+
+    // whether the timeline sets the input at or before a given time
+    bool hasInputAt(unsigned long micros) const { return !timeline().empty() && qTimeline.frontTime() <= micros; }
+
+    // the input value at a given time apart from queued input, in O(log n): the timeline's once it
+    // has started, otherwise the generator's, otherwise the pin's current value
+    T inputAt(unsigned long micros) const {
+      sortTimeline();
+      unsigned long pos = qTimeline.upperBound(micros);
+      if (pos) return qTimeline.at(pos - 1).data;
+      return mGenerator ? mGenerator(micros) : (T)(*this);
+    }
+
+    // the first time after a given one, and no more than within microseconds after it, that the
+    // input (apart from queued input) changes to a given value.  false if there is none.
+    // timeline changes are found by binary search.  a generator, until the timeline starts, is
+    // followed from change to change if it can say where they are, and otherwise sampled every
+    // microsecond of the window
+    bool nextInputAt(unsigned long after, T value, unsigned long& at, unsigned long within) const {
+      sortTimeline();
+      if (mGenerator) {
+        unsigned long t = after;
+        while (true) {
+          unsigned long next = t + 1;
+          if (mGeneratorNextChange && !mGeneratorNextChange(t, next)) break;
+          if (next - after > within || next - after <= t - after) break;  // beyond the window, or wrapped
+          if (!qTimeline.empty() && qTimeline.frontTime() <= next) break;
+          if (mGenerator(next) == value) {
+            at = next;
+            return true;
+          }
+          t = next;
+        }
+      }
+
+      const std::vector<unsigned long>& changes = timelineChanges();
+      unsigned long from = qTimeline.upperBound(after);
+      for (std::vector<unsigned long>::const_iterator it = std::lower_bound(changes.begin(), changes.end(), from); it != changes.end(); ++it) {
+        typename MockEventQueue<T>::Event e = qTimeline.at(*it);
+        if (e.micros - after > within) return false;
+        if (e.data == value) {
+          at = e.micros;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    // the value the pin had at a given time according to its history, in O(log n).
+    // before the first recorded event this is the default value of T
+    T valueAt(unsigned long micros) const {
+      unsigned long pos = qOut.upperBound(micros);
+      return pos ? qOut.at(pos - 1).data : T();
+    }
+
+    // the history events stamped at or after t0 and before t1, found in O(log n)
+    typename MockEventQueue<T>::const_range eventsBetween(unsigned long t0, unsigned long t1) const {
+      return qOut.range(qOut.lowerBound(t0), qOut.lowerBound(t1));
+    }
+
+    // number of low-to-high transitions stamped at or after t0 and before t1
+    unsigned long risingEdges(unsigned long t0 = 0, unsigned long t1 = ULONG_MAX) const { return countEdges(true, t0, t1); }
+
+    // number of high-to-low transitions stamped at or after t0 and before t1
+    unsigned long fallingEdges(unsigned long t0 = 0, unsigned long t1 = ULONG_MAX) const { return countEdges(false, t0, t1); }
+
+    // fraction of the time from t0 to t1 that the pin was high (nonzero)
+    double dutyCycle(unsigned long t0, unsigned long t1) const {
+      if (t1 <= t0) return 0.0;
+      unsigned long pos = qOut.upperBound(t0);
+      bool level = pos ? (bool)qOut.at(pos - 1).data : false;
+      unsigned long last = t0;
+      unsigned long timeHigh = 0;
+      for (typename MockEventQueue<T>::const_iterator it = qOut.iteratorAt(pos); it != qOut.end() && it->micros < t1; ++it) {
+        if (level) timeHigh += it->micros - last;
+        last = it->micros;
+        level = (bool)it->data;
+      }
+      if (level) timeHigh += t1 - last;
+      return (double)timeHigh / (double)(t1 - t0);
+    }
+
+    // number of complete high (or low) pulses that both start and end at or after t0 and before t1
+    unsigned long pulseCount(bool high, unsigned long t0 = 0, unsigned long t1 = ULONG_MAX) const {
+      unsigned long count, shortest, longest;
+      measurePulses(high, t0, t1, count, shortest, longest);
+      return count;
+    }
+
+    // width in microseconds of the shortest complete pulse in the window, or 0 if there was none
+    unsigned long minPulseWidth(bool high, unsigned long t0 = 0, unsigned long t1 = ULONG_MAX) const {
+      unsigned long count, shortest, longest;
+      measurePulses(high, t0, t1, count, shortest, longest);
+      return shortest;
+    }
+
+    // width in microseconds of the longest complete pulse in the window, or 0 if there was none
+    unsigned long maxPulseWidth(bool high, unsigned long t0 = 0, unsigned long t1 = ULONG_MAX) const {
+      unsigned long count, shortest, longest;
+      measurePulses(high, t0, t1, count, shortest, longest);
+      return longest;
+    }
+
     // copy data elements to an array, up to a given length
     // return the number of elements moved
     int toArray (T* arr, unsigned int length) const {
-      MockEventQueue<T> q2(qOut);  // preserve const by copying
-
       int ret = 0;
-      for (int i = 0; i < length && q2.size(); ++i) {
-        arr[i] = q2.frontData();
-        q2.pop();
-        ++ret;
+      for (typename MockEventQueue<T>::const_iterator it = begin(); ret < length && it != end(); ++it) {
+        arr[ret++] = it->data;
       }
       return ret;
     }
@@ -160,13 +608,9 @@ class PinHistory : public ObservableDataStream {
     // note that this records times between calls to the pin, not between transitions
     // return the number of elements moved
     int toTimestampArray(unsigned long* arr, unsigned int length) const {
-      MockEventQueue<T> q2(qOut);  // preserve const by copying
-
       int ret = 0;
-      for (int i = 0; i < length && q2.size(); ++i) {
-        arr[i] = q2.frontTime();
-        q2.pop();
-        ++ret;
+      for (typename MockEventQueue<T>::const_iterator it = begin(); ret < length && it != end(); ++it) {
+        arr[ret++] = it->micros;
       }
       return ret;
     }
@@ -175,26 +619,14 @@ class PinHistory : public ObservableDataStream {
     // note that this records times between calls to the pin, not between transitions
     // return the number of elements moved
     int toEventArray(typename MockEventQueue<T>::Event* arr, unsigned int length) const {
-      MockEventQueue<T> q2(qOut);  // preserve const by copying
-
       int ret = 0;
-      for (int i = 0; i < length && q2.size(); ++i) {
-        arr[i] = q2.front();
-        q2.pop();
-        ++ret;
+      for (typename MockEventQueue<T>::const_iterator it = begin(); ret < length && it != end(); ++it) {
+        arr[ret++] = *it;
       }
       return ret;
     }
 
     // see if the array matches the data of the elements in the queue
-    bool hasElements (T const * const arr, unsigned int length) const {
-      int i;
-      MockEventQueue<T> q2(qOut);  // preserve const by copying
-      for (i = 0; i < length && q2.size(); ++i) {
-        if (q2.frontData() != arr[i]) return false;
-        q2.pop();
-      }
-      return i == length;
-    }
+    bool hasElements (T const * const arr, unsigned int length) const { return qHas(qOut, arr, length); }
 
 };
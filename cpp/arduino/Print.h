@@ -18,6 +18,19 @@ class Print
 {
   private:
     int write_error;
+
+    // as the Arduino core's: uppercase digits, and bases below 2 mean decimal
+    size_t printNumber(unsigned long n, uint8_t base) {
+      char buf[ArduinoCINumberFormat::INTEGER_CHARS];
+      char *end = buf + sizeof(buf);
+      char *first = ArduinoCINumberFormat::digits(n, base < 2 ? 10 : base, end, true);
+      return write(first, end - first);
+    }
+
+    size_t printFloat(double number, uint8_t digits) {
+      char buf[ArduinoCINumberFormat::FLOAT_CHARS];
+      return write(buf, ArduinoCINumberFormat::printFloat(number, digits, buf));
+    }
   protected:
     void setWriteError(int err = 1) { write_error = err; }
   public:
@@ -28,7 +41,7 @@ class Print
     virtual int availableForWrite() { return 0; }
 
     virtual size_t write(uint8_t) = 0;
-    size_t write(const char *str) { return str == NULL ? 0 : write((const uint8_t *)str, String(str).length()); }
+    size_t write(const char *str) { return str == NULL ? 0 : write((const uint8_t *)str, strlen(str)); }
 
     virtual size_t write(const uint8_t *buffer, size_t size) {
       size_t n;
@@ -40,27 +53,31 @@ class Print
 
     size_t print(const String &s)                 { return write(s.c_str(), s.length()); }
     size_t print(const __FlashStringHelper *str)  { return print(reinterpret_cast<PGM_P>(str)); }
-    size_t print(const char* str)                 { return print(String(str)); }
-    size_t print(char c)                          { return print(String(c)); }
-    size_t print(unsigned char b, int base = DEC) { return print(String(b, base)); }
-    size_t print(int n,           int base = DEC) { return print(String(n, base)); }
-    size_t print(unsigned int n,  int base = DEC) { return print(String(n, base)); }
-    size_t print(long n,          int base = DEC) { return print(String(n, base)); }
-    size_t print(unsigned long n, int base = DEC) { return print(String(n, base)); }
-    size_t print(double n,        int base = DEC) { return print(String(n, base)); }
+    size_t print(const char* str)                 { return write(str); }
+    size_t print(char c)                          { return write((uint8_t)c); }
+    size_t print(unsigned char b, int base = DEC) { return print((unsigned long)b, base); }
+    size_t print(int n,           int base = DEC) { return print((long)n, base); }
+    size_t print(unsigned int n,  int base = DEC) { return print((unsigned long)n, base); }
+    size_t print(long n,          int base = DEC) {
+      if (base == 0) return write((uint8_t)n);
+      if (base == 10 && n < 0) return print('-') + printNumber(0UL - (unsigned long)n, 10);
+      return printNumber(n, base);
+    }
+    size_t print(unsigned long n, int base = DEC) { return base == 0 ? write((uint8_t)n) : printNumber(n, base); }
+    size_t print(double n,        int digits = 2) { return printFloat(n, digits); }
     size_t print(const Printable& x)              { return x.printTo(*this); }
 
-    size_t println(void)                              { return print("\r\n"); }
+    size_t println(void)                              { return write("\r\n", 2); }
     size_t println(const String &s)                   { return print(s) + println(); }
     size_t println(const __FlashStringHelper *str)    { return println(reinterpret_cast<PGM_P>(str)); }
-    size_t println(const char* c)                     { return println(String(c)); }
-    size_t println(char c)                            { return println(String(c)); }
-    size_t println(unsigned char b,   int base = DEC) { return println(String(b, base)); }
-    size_t println(int num,           int base = DEC) { return println(String(num, base)); }
-    size_t println(unsigned int num,  int base = DEC) { return println(String(num, base)); }
-    size_t println(long num,          int base = DEC) { return println(String(num, base)); }
-    size_t println(unsigned long num, int base = DEC) { return println(String(num, base)); }
-    size_t println(double num,        int base = DEC) { return println(String(num, base)); }
+    size_t println(const char* c)                     { return print(c) + println(); }
+    size_t println(char c)                            { return print(c) + println(); }
+    size_t println(unsigned char b,   int base = DEC) { return print(b, base) + println(); }
+    size_t println(int num,           int base = DEC) { return print(num, base) + println(); }
+    size_t println(unsigned int num,  int base = DEC) { return print(num, base) + println(); }
+    size_t println(long num,          int base = DEC) { return print(num, base) + println(); }
+    size_t println(unsigned long num, int base = DEC) { return print(num, base) + println(); }
+    size_t println(double num,        int digits = 2) { return print(num, digits) + println(); }
     size_t println(const Printable& x)                { return print(x) + println(); }
 
     virtual void flush() { }
@@ -52,7 +52,7 @@ public:
 class SPIClass: public ObservableDataStream {
 public:
 
-  SPIClass(String* dataIn, String* dataOut) {
+  SPIClass(ArduinoCIStreamInput dataIn, String* dataOut) {
     this->dataIn = dataIn;
     this->dataOut = dataOut;
   }
@@ -91,8 +91,8 @@ public:
 
     // pop bus->memory data from its queue and return it
     if (dataIn->empty()) return 0;
-    char ret = (*dataIn)[0];
-    *dataIn = dataIn->substr(1, dataIn->length());
+    char ret = dataIn->data()[0];
+    dataIn->consume(1);
     return ret;
   }
 
@@ -151,8 +151,8 @@ private:
 
   bool isStarted = false;
   uint8_t bitOrder;
-  String* dataIn;
+  ArduinoCIStreamInput dataIn;
   String* dataOut;
 };
 
-extern SPIClass SPI;
+extern thread_local SPIClass SPI;
@@ -46,18 +46,16 @@ class SoftwareSerial : public Stream
     void end() { stopListening(); }
     bool overflow() { return false; }
 
+    // only the byte at the front of the pin's input queue is decoded, so these are O(1)
     int peek() {
       if (!isListening()) return -1;
-      String input = mState->digitalPin[mPinIn].incomingToAscii(mOffset, bigEndian);
-      if (input.empty()) return -1;
-      return input[0];
+      int ret = mState->digitalPin[mPinIn].incomingAsciiFront(mOffset, bigEndian);
+      return ret == -1 ? -1 : (int)(char)ret;
     }
 
     virtual int read() {
-      if (!isListening()) return -1;
-      String input = mState->digitalPin[mPinIn].incomingToAscii(mOffset, bigEndian);
-      if (input.empty()) return -1;
-      int ret = input[0];
+      int ret = peek();
+      if (ret == -1) return -1;
       for (int i = 0; i < 8; ++i) digitalRead(mPinIn);
       return ret;
     }
@@ -69,7 +67,7 @@ class SoftwareSerial : public Stream
       return 1;
     }
 
-    virtual int available() { return mState->digitalPin[mPinIn].incomingToAscii(mOffset, bigEndian).length();  }
+    virtual int available() { return mState->digitalPin[mPinIn].incomingAsciiLength(mOffset); }
     virtual void flush() {}
     operator bool() { return true; }
 
@@ -2,6 +2,7 @@
 #include "Godmode.h"
 #include "WString.h"
 #include "Print.h"
+#include "ci/StreamBuffer.h"
 
 // This enumeration provides the lookahead options for parseInt(), parseFloat()
 // The rules set out here are used until either the first valid character is found
@@ -17,35 +18,51 @@ enum LookaheadMode{
 class Stream : public Print
 {
   public:
-    String* mGodmodeDataIn;
+    ArduinoCIStreamInput mGodmodeDataIn;  // an ArduinoCIStreamBuffer* or a String*
     unsigned long* mGodmodeMicrosDelay;
 
   protected:
     unsigned long mTimeoutMillis;
 
-    void fastforward(int pos) {
-      mGodmodeDataIn->assign(mGodmodeDataIn->substring(pos));
+    void fastforward(size_t pos) {
+      mGodmodeDataIn->consume(pos);
     }
 
-    char fastforwardToAnyChar(LookaheadMode lookahead, String chars) {
-      char c;
-      while ((c = peek()) != -1) {
-        if (chars.find(c) != String::npos) return c;
-        if (lookahead == SKIP_NONE) return -1;
-        if (lookahead == SKIP_WHITESPACE && !isWhitespace(c)) return -1;
-        read();
+    // consume input that was parsed in place, paying the per-byte read delay as read() would
+    void consumeParsed(size_t count) {
+      fastforward(count);
+      if (mGodmodeMicrosDelay && count) delayMicroseconds(*mGodmodeMicrosDelay * count);
+    }
+
+    static inline bool isAsciiDigit(char c) { return c >= '0' && c <= '9'; }
+
+    // as in the Arduino core: discard input until something that can start a number,
+    // as far as the lookahead mode allows.  returns that character, or -1
+    int peekNextDigit(LookaheadMode lookahead, bool detectDecimal) {
+      const char* p = mGodmodeDataIn->data();
+      size_t n = mGodmodeDataIn->length();
+      size_t i = 0;
+      int ret = -1;
+      for (; i < n; ++i) {
+        char c = p[i];
+        if (c == '-' || isAsciiDigit(c) || (detectDecimal && c == '.')) {
+          ret = c;
+          break;
+        }
+        if (lookahead == SKIP_NONE) break;
+        if (lookahead == SKIP_WHITESPACE && c != ' ' && c != '\t' && c != '\r' && c != '\n') break;
       }
-      return -1;
+      consumeParsed(i);
+      return ret;
     }
 
     // int timedRead();    // read stream with timeout
     // int timedPeek();    // peek stream with timeout
-    // int peekNextDigit(LookaheadMode lookahead, bool detectDecimal); // returns the next numeric digit in the stream or -1 if timeout
 
   public:
     virtual int available() { return mGodmodeDataIn->length(); }
 
-    virtual int peek() { return available() ? (int)((*mGodmodeDataIn)[0]) : -1; }
+    virtual int peek() { return mGodmodeDataIn->empty() ? -1 : (int)(mGodmodeDataIn->data()[0]); }
 
     virtual int read() {
       int ret = peek();
@@ -59,12 +76,12 @@ class Stream : public Print
     // https://stackoverflow.com/a/4271276
     using Print::write;
 
-    virtual size_t write(uint8_t aChar) { mGodmodeDataIn->append(String((char)aChar)); return 1; }
+    virtual size_t write(uint8_t aChar) { mGodmodeDataIn->append((char)aChar); return 1; }
 
     Stream() {
       mTimeoutMillis = 1000;
       mGodmodeMicrosDelay = NULL;
-      mGodmodeDataIn = NULL;
+      mGodmodeDataIn = nullptr;
     }
 
 
@@ -72,28 +89,37 @@ class Stream : public Print
     unsigned long getTimeout(void) { return mTimeoutMillis; }
 
     bool find(const String &s) {
-      long idx;
-      if ((idx = mGodmodeDataIn->find(s)) != String::npos) {
+      size_t idx;
+      if ((idx = mGodmodeDataIn->find(s)) != ArduinoCIStreamInput::npos) {
+        fastforward(idx);
+        return true;
+      }
+      return false;
+    }
+
+    bool find(const char *target, size_t length) {
+      size_t idx;
+      if ((idx = mGodmodeDataIn->find(target, length)) != ArduinoCIStreamInput::npos) {
         fastforward(idx);
         return true;
       }
       return false;
     }
 
-    bool find(char *target)                   { return find(String(target)); }
-    bool find(uint8_t *target)                { return find(String((char*)target)); }
-    bool find(char *target, size_t length)    { return find(String(string(target, length))); }
-    bool find(uint8_t *target, size_t length) { return find(String(string((char*)target, length))); }
-    bool find(char target)                    { return find(String(string(&target, 1))); }
+    bool find(char *target)                   { return find(target, strlen(target)); }
+    bool find(uint8_t *target)                { return find((char*)target); }
+    bool find(char *target, size_t length)    { return find((const char*)target, length); }
+    bool find(uint8_t *target, size_t length) { return find((const char*)target, length); }
+    bool find(char target)                    { return find(&target, 1); }
 
     bool findUntil(const String &target, const String &terminator) {
       long idxTgt = mGodmodeDataIn->find(target);
       long idxTrm = mGodmodeDataIn->find(terminator);
-      if (idxTgt == String::npos) {
+      if (idxTgt == ArduinoCIStreamInput::npos) {
         mGodmodeDataIn->clear();
         return false; // didn't find it
       }
-      if (idxTrm != String::npos || idxTrm < idxTgt) {
+      if (idxTrm != ArduinoCIStreamInput::npos || idxTrm < idxTgt) {
         fastforward(idxTrm);
         return false;  // target found after term
       }
@@ -115,43 +141,61 @@ class Stream : public Print
     // Lookahead is terminated by the first character that is not a valid part of an integer.
     // Once parsing commences, 'ignore' will be skipped in the stream.
     long parseInt(LookaheadMode lookahead = SKIP_ALL, char ignore = NO_IGNORE_CHAR) {
-      String digits = "1234567890";
-      if (fastforwardToAnyChar(lookahead, digits + "-") == -1) return 0;
-      String out = String((char)read()); // read unconditionally -- might be a minus
-      char c;
-      bool keepGoing = true;
+      if (peekNextDigit(lookahead, false) == -1) return 0;
+
+      // scan the input in place, with the Arduino core's rules: a minus sign anywhere in the run
+      // negates, and the value wraps rather than saturating
+      const char* p = mGodmodeDataIn->data();
+      size_t n = mGodmodeDataIn->length();
+      size_t i = 0;
+      bool isNegative = false;
+      unsigned long value = 0;
       do {
-        c = peek();
-        if (c == -1) break;
-        if (c != ignore || ignore == NO_IGNORE_CHAR) out += c;
-        keepGoing = digits.find(c) != String::npos;
-        if (!keepGoing) break;
-        read();
-      } while (true);
-      return out.toInt();
+        char c = p[i];
+        if (c == ignore) {
+          // skip it
+        } else if (c == '-') {
+          isNegative = true;
+        } else if (isAsciiDigit(c)) {
+          value = value * 10 + (c - '0');
+        }
+        ++i;
+      } while (i < n && (isAsciiDigit(p[i]) || p[i] == ignore));
+      consumeParsed(i);
+      return (long)(isNegative ? 0 - value : value);
     }
 
     float parseFloat(LookaheadMode lookahead = SKIP_ALL, char ignore = NO_IGNORE_CHAR) {
-      String digits = "1234567890";
-      if (fastforwardToAnyChar(lookahead, digits + "-") == -1) return 0;
-      String out = String((char)read()); // read unconditionally -- might be a minus
-      String bank = digits + ".";
-      bool gotDot = false;
-      bool keepGoing = true;
-      char c;
+      if (peekNextDigit(lookahead, true) == -1) return 0;
+
+      // as parseInt, accumulating in double the way the Arduino core does, so results round alike
+      const char* p = mGodmodeDataIn->data();
+      size_t n = mGodmodeDataIn->length();
+      size_t i = 0;
+      bool isNegative = false;
+      bool isFraction = false;
+      double value = 0.0;
+      double fraction = 1.0;
       do {
-        c = peek();
-        if (c == -1) break;
-        if (c == '.') {       // waiting for gotDot
-          if (gotDot) break;
-          gotDot = true;
+        char c = p[i];
+        if (c == ignore) {
+          // skip it
+        } else if (c == '-') {
+          isNegative = true;
+        } else if (c == '.') {
+          isFraction = true;
+        } else if (isAsciiDigit(c)) {
+          if (isFraction) {
+            fraction *= 0.1;
+            value = value + fraction * (c - '0');
+          } else {
+            value = value * 10 + (c - '0');
+          }
         }
-        if (c != ignore || ignore == NO_IGNORE_CHAR) out += c;
-        keepGoing = bank.find(c) != String::npos;
-        if (!keepGoing) break;
-        read();
-      } while (true);
-      return out.toFloat();
+        ++i;
+      } while (i < n && (isAsciiDigit(p[i]) || (p[i] == '.' && !isFraction) || p[i] == ignore));
+      consumeParsed(i);
+      return isNegative ? -value : value;
     }
 
     // read chars from stream into buffer
@@ -171,7 +215,7 @@ class Stream : public Print
     // returns the number of characters placed in the buffer (0 means no valid data found)
     size_t readBytesUntil(char terminator, char *buffer, size_t length) {
       size_t idx = mGodmodeDataIn->find(terminator);
-      size_t howMuch = idx == String::npos ? length : min(length, idx);
+      size_t howMuch = idx == ArduinoCIStreamInput::npos ? length : min(length, idx);
       return readBytes(buffer, howMuch);
     }
 
@@ -180,20 +224,18 @@ class Stream : public Print
     size_t readBytesUntil(char terminator, uint8_t *buffer, size_t length) { return readBytesUntil(terminator, (char *)buffer, length); }
 
     String readStringUntil(char terminator) {
-      long idxTrm = mGodmodeDataIn->find(terminator);
-      String ret;
-      if (idxTrm == String::npos) {
-        ret = String(*mGodmodeDataIn);
+      size_t idxTrm = mGodmodeDataIn->find(terminator);
+      String ret = mGodmodeDataIn->toString(idxTrm);
+      if (idxTrm == ArduinoCIStreamInput::npos) {
         mGodmodeDataIn->clear();
       } else {
-        ret = mGodmodeDataIn->substring(0, idxTrm);
         fastforward(idxTrm + 1);
       }
       return ret;
     }
 
     String readString() {
-      String ret(*mGodmodeDataIn);
+      String ret = mGodmodeDataIn->toString();
       mGodmodeDataIn->clear();
       return ret;
     }
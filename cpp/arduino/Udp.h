@@ -9,19 +9,19 @@ protected:
 
 public:
   UDP() {
-    // The Stream mock defines a String buffer but never puts anything in it!
+    // The Stream mock defines an input buffer but never puts anything in it!
     if (!mGodmodeDataIn) {
-      mGodmodeDataIn = new String;
+      mGodmodeDataIn = new ArduinoCIStreamBuffer;
     }
   }
   ~UDP() {
     if (mGodmodeDataIn) {
-      delete mGodmodeDataIn;
+      delete mGodmodeDataIn.buffer();
       mGodmodeDataIn = nullptr;
     }
   }
   virtual size_t write(uint8_t value) {
-    mGodmodeDataIn->concat(value);
+    mGodmodeDataIn->append((char)value);
     return 1;
   }
 };
@@ -5,27 +5,14 @@
 #include <string.h>
 #include <algorithm>
 #include <iostream>
+#include <type_traits>
+#include <utility>
 #include "AvrMath.h"
 #include "WCharacter.h"
+#include "ci/NumberFormat.h"
 
 typedef std::string string;
 
-// work around some portability issues
-#if defined(__clang__)
-  #define ARDUINOCI_ISNAN isnan
-  #define ARDUINOCI_ISINF isinf
-#elif defined(__GNUC__) || defined(__GNUG__)
-  #define ARDUINOCI_ISNAN std::isnan
-  #define ARDUINOCI_ISINF std::isinf
-#elif defined(_MSC_VER)
-  // TODO: no idea
-  #define ARDUINOCI_ISNAN ::isnan
-  #define ARDUINOCI_ISINF ::isinf
-#else
-  #define ARDUINOCI_ISNAN ::isnan
-  #define ARDUINOCI_ISINF ::isinf
-#endif
-
 class __FlashStringHelper;
 #define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(PSTR(string_literal)))
 
@@ -33,32 +20,18 @@ class __FlashStringHelper;
 class String: public string
 {
   private:
-    static const char *digit(int val)
-    {
-      static const char *bank = "0123456789ABCDEF";
-      return bank + val;
-    }
-
-    static string mytoa(unsigned long val, int base) {
-      int n = val % base;
-      string place = string(digit(n), 1);
-      if (val < base) return place;
-      return mytoa(val / base, base) + place;
-    }
-
-    static string mytoas(long val, int base) {
-      string ret = mytoa(abs(val), base);
-      return 0 <= val ? ret : string("-") + ret;
+    // append a number formatted as the AVR core's String does it (see ci/NumberFormat.h)
+    template <typename T>
+    void appendInteger(T val, unsigned char base) {
+      char buf[ArduinoCINumberFormat::INTEGER_CHARS];
+      char *end = buf + sizeof(buf);
+      char *first = ArduinoCINumberFormat::libc(val, base, end);
+      append(first, end - first);
     }
 
-    static string dtoas(double val, int decimalPlaces) {
-      double r = 0.5 * pow(0.1, decimalPlaces); // make sure that integer truncation will properly round
-      if (ARDUINOCI_ISNAN(val)) return "nan";
-      if (ARDUINOCI_ISINF(val)) return "inf";
-      val += val > 0 ? r : -r;
-      if (val > 4294967040.0) return "ovf";
-      if (val <-4294967040.0) return "ovf";
-      return mytoas(val, 10) + "." + mytoa(abs(val - (long)val) * pow(10, decimalPlaces), 10);
+    void appendFloat(double val, unsigned char decimalPlaces) {
+      char buf[ArduinoCINumberFormat::FLOAT_CHARS];
+      append(buf, ArduinoCINumberFormat::dtostrf(val, (signed char)(decimalPlaces + 2), decimalPlaces, buf));
     }
 
   public:
@@ -67,18 +40,20 @@ class String: public string
     String(const char *cstr = ""): string(cstr) {}
     String(const string &str): string(str) {}
     String(const String &str): string(str) {}
+    String(string &&str) noexcept: string(std::move(str)) {}
+    String(String &&str) noexcept: string(std::move(str)) {}
     explicit String(char c): string(1, c) {}
 
-    explicit String(unsigned char val, unsigned char base=10): string(mytoa(val, base)) {}
-    explicit String(int val,           unsigned char base=10): string(mytoas(val, base)) {}
-    explicit String(unsigned int val , unsigned char base=10): string(mytoa(val, base)) {}
-    explicit String(long val,          unsigned char base=10): string(mytoas(val, base)) {}
-    explicit String(unsigned long val, unsigned char base=10): string(mytoa(val, base)) {}
-    explicit String(long long val,     unsigned char base=10): string(mytoas(val, base)) {}
-    explicit String(unsigned long long val, unsigned char base=10): string(mytoa(val, base)) {}
+    explicit String(unsigned char val, unsigned char base=10)      { appendInteger(val, base); }
+    explicit String(int val,           unsigned char base=10)      { appendInteger(val, base); }
+    explicit String(unsigned int val , unsigned char base=10)      { appendInteger(val, base); }
+    explicit String(long val,          unsigned char base=10)      { appendInteger(val, base); }
+    explicit String(unsigned long val, unsigned char base=10)      { appendInteger(val, base); }
+    explicit String(long long val,     unsigned char base=10)      { appendInteger(val, base); }
+    explicit String(unsigned long long val, unsigned char base=10) { appendInteger(val, base); }
 
-    explicit String(float val,  unsigned char decimalPlaces=2): string(dtoas(val, decimalPlaces)) {}
-    explicit String(double val, unsigned char decimalPlaces=2): string(dtoas(val, decimalPlaces)) {}
+    explicit String(float val,  unsigned char decimalPlaces=2) { appendFloat(val, decimalPlaces); }
+    explicit String(double val, unsigned char decimalPlaces=2) { appendFloat(val, decimalPlaces); }
 
       operator bool() const {
         return true;
@@ -86,25 +61,37 @@ class String: public string
 
     String & operator = (const String &rhs) { assign(rhs); return *this; }
     String & operator = (const string &rhs) { assign(rhs); return *this; }
+    String & operator = (String &&rhs) noexcept { string::operator=(std::move(rhs)); return *this; }
+    String & operator = (string &&rhs) noexcept { string::operator=(std::move(rhs)); return *this; }
     String & operator = (const char *cstr)  { assign(cstr); return *this; }
     String & operator = (const char c)      { assign(1, c); return *this; }
 
     unsigned char concat(const __FlashStringHelper *str) { append((const char *)str); return 1; }
     unsigned char concat(const String &str) { append(str); return 1; }
+    unsigned char concat(String &&str) {
+      // nothing to append to: take the other string's buffer instead of copying it
+      if (empty() && str.capacity() >= capacity()) {
+        string::operator=(std::move(str));
+      } else {
+        append(str);
+      }
+      return 1;
+    }
     unsigned char concat(const char *cstr)  { append(cstr); return 1; }
     unsigned char concat(char c)            { append(1, c); return 1; }
     unsigned char concat(unsigned char c)   { append(1, c); return 1; }
-    unsigned char concat(int num)           { append(String(num)); return 1; }
-    unsigned char concat(unsigned int num)  { append(String(num)); return 1; }
-    unsigned char concat(long num)          { append(String(num)); return 1; }
-    unsigned char concat(unsigned long num) { append(String(num)); return 1; }
-    unsigned char concat(long long num)     { append(String(num)); return 1; }
-    unsigned char concat(unsigned long long num) { append(String(num)); return 1; }
-    unsigned char concat(float num)         { append(String(num)); return 1; }
-    unsigned char concat(double num)        { append(String(num)); return 1; }
+    unsigned char concat(int num)           { appendInteger(num, 10); return 1; }
+    unsigned char concat(unsigned int num)  { appendInteger(num, 10); return 1; }
+    unsigned char concat(long num)          { appendInteger(num, 10); return 1; }
+    unsigned char concat(unsigned long num) { appendInteger(num, 10); return 1; }
+    unsigned char concat(long long num)     { appendInteger(num, 10); return 1; }
+    unsigned char concat(unsigned long long num) { appendInteger(num, 10); return 1; }
+    unsigned char concat(float num)         { appendFloat(num, 2); return 1; }
+    unsigned char concat(double num)        { appendFloat(num, 2); return 1; }
 
     String & operator += (const __FlashStringHelper *rhs) { concat(rhs);  return *this; }
     String & operator += (const String &rhs) { concat(rhs);  return *this; }
+    String & operator += (String &&rhs)      { concat(std::move(rhs)); return *this; }
     String & operator += (const char *cstr)  { concat(cstr); return *this; }
     String & operator += (char c)            { concat(c);    return *this; }
     String & operator += (unsigned char num) { concat(num);  return *this; }
@@ -118,17 +105,29 @@ class String: public string
     String & operator += (double num)        { concat(num);  return *this; }
 
 
+    // as Arduino's: never shrinks, and returns 0 if the memory can't be had
+    unsigned char reserve(unsigned int size) {
+      try {
+        if (size > capacity()) string::reserve(size);
+        return 1;
+      } catch (const std::exception&) {
+        return 0;
+      }
+    }
+
     int compareTo(const String &s) const { return compare(s); }
     unsigned char equals(const String &s) const { return compareTo(s) == 0; }
-    unsigned char equals(const char *cstr) const { return compareTo(String(cstr)) == 0; }
+    unsigned char equals(const char *cstr) const { return compare(cstr) == 0; }
     unsigned char equal(const String &s) const { return equals(s); }
     unsigned char equal(const char *cstr) const { return equals(cstr); }
     unsigned char equalsIgnoreCase(const String &s) const {
-      String a = String(*this);
-      String b = String(s);
-      a.toUpperCase();
-      b.toUpperCase();
-      return a.compare(b) == 0;
+      if (length() != s.length()) return 0;
+      const char *a = data();
+      const char *b = s.data();
+      for (size_t i = 0; i < length(); ++i) {
+        if (a[i] != b[i] && ::tolower((unsigned char)a[i]) != ::tolower((unsigned char)b[i])) return 0;
+      }
+      return 1;
     }
 
     unsigned char startsWith(const String &prefix) const { return find(prefix) == 0; }
@@ -153,27 +152,68 @@ class String: public string
     String substring( unsigned int beginIndex ) const { return String(substr(beginIndex)); }
     String substring( unsigned int beginIndex, unsigned int endIndex ) const { return String(substr(beginIndex, endIndex)); }
 
+    // every match, left to right, is replaced in a single pass: in place when the replacement is
+    // no longer than the target, otherwise into one buffer of the final length
     void replace(const String& target, const String& repl) {
-      int i = 0;
-      while ((i = find(target, i)) != npos) {
-        assign(substr(0, i) + repl + substr(i + target.length()));
-        i += repl.length();
+      size_t tlen = target.length();
+      size_t rlen = repl.length();
+      if (tlen == 0 || length() < tlen) return;
+
+      if (rlen <= tlen) {
+        // copy down over the gaps the shorter replacements leave
+        char *buf = &(*this)[0];
+        size_t len = length();
+        size_t out = 0;
+        size_t in = 0;
+        for (size_t i = find(target); i != npos; i = find(target, in)) {
+          if (out != in) memmove(buf + out, buf + in, i - in);
+          out += i - in;
+          memcpy(buf + out, repl.data(), rlen);
+          out += rlen;
+          in = i + tlen;
+        }
+        if (out == in) return;  // nothing moved: either no match, or equal lengths in place
+        memmove(buf + out, buf + in, len - in);
+        resize(out + len - in);
+        return;
+      }
+
+      size_t matches = 0;
+      for (size_t i = find(target); i != npos; i = find(target, i + tlen)) ++matches;
+      if (matches == 0) return;
+
+      // longer: build the result once, in a buffer of its final size
+      string result;
+      result.reserve(length() + matches * (rlen - tlen));
+      size_t in = 0;
+      for (size_t i = find(target); i != npos; i = find(target, in)) {
+        result.append(data() + in, i - in);
+        result.append(repl);
+        in = i + tlen;
       }
+      result.append(data() + in, length() - in);
+      swap(result);
     }
+
     void replace(char target, char repl) {
-      replace(String(target), String(repl));
+      // memchr does the scanning a word or vector at a time
+      char *p = &(*this)[0];
+      char *end = p + length();
+      while ((p = (char *)memchr(p, target, end - p)) != nullptr) *p++ = repl;
     }
-    void remove(unsigned int index) { assign(substr(0, index)); }
-    void remove(unsigned int index, unsigned int count) { assign(substr(0, index) + substr(min(length(), index + count), count)); }
+
+    void remove(unsigned int index) { if (index < length()) erase(index); }
+    void remove(unsigned int index, unsigned int count) { if (index < length()) erase(index, count); }
     void toLowerCase(void) { std::transform(begin(), end(), begin(), ::tolower); }
     void toUpperCase(void) { std::transform(begin(), end(), begin(), ::toupper); }
 
     void trim(void) {
-      int b;
-      int e;
-      for (b = 0; b < length() && isSpace(charAt(b)); ++b);
-      for (e = length() - 1; e > b && isSpace(charAt(e)); --e);
-      assign(substr(b, e - b + 1));
+      size_t e = length();
+      while (e > 0 && isSpace((*this)[e - 1])) --e;
+      size_t b = 0;
+      while (b < e && isSpace((*this)[b])) ++b;
+      resize(e);
+      if (b) erase(0, b);
     }
 
     float toFloat(void) const   { return std::stof(*this); }
@@ -188,6 +228,66 @@ class String: public string
 
 };
 
+// Concatenation builds on the left operand, so a chain like a + b + c reuses one buffer.
+//
+// There is an overload for each type String::operator+= takes, as in the Arduino core.  The
+// String operands are template parameters that must be exactly String, never converted to it,
+// so expressions mixing String and std::string keep resolving to std::string's operator+.
+template <typename L, typename R = String>
+using ArduinoCIStringSum = typename std::enable_if<std::is_same<L, String>::value && std::is_same<R, String>::value, String>::type;
+
+template <typename L, typename R>
+inline ArduinoCIStringSum<L, R> operator + (const L &lhs, const R &rhs) {
+  String ret(lhs);
+  ret += rhs;
+  return ret;
+}
+
+template <typename L, typename R>
+inline ArduinoCIStringSum<L, R> operator + (L &&lhs, const R &rhs) {
+  lhs += rhs;
+  return std::move(lhs);
+}
+
+#define arduinoCIStringSumOverloads(T)                                 \
+  template <typename L>                                                \
+  inline ArduinoCIStringSum<L> operator + (const L &lhs, T rhs) {      \
+    String ret(lhs);                                                   \
+    ret += rhs;                                                        \
+    return ret;                                                        \
+  }                                                                    \
+  template <typename L>                                                \
+  inline ArduinoCIStringSum<L> operator + (L &&lhs, T rhs) {           \
+    lhs += rhs;                                                        \
+    return std::move(lhs);                                             \
+  }
+
+arduinoCIStringSumOverloads(const __FlashStringHelper *)
+arduinoCIStringSumOverloads(const char *)
+arduinoCIStringSumOverloads(char)
+arduinoCIStringSumOverloads(unsigned char)
+arduinoCIStringSumOverloads(int)
+arduinoCIStringSumOverloads(unsigned int)
+arduinoCIStringSumOverloads(long)
+arduinoCIStringSumOverloads(unsigned long)
+arduinoCIStringSumOverloads(long long)
+arduinoCIStringSumOverloads(unsigned long long)
+arduinoCIStringSumOverloads(float)
+arduinoCIStringSumOverloads(double)
+
+#undef arduinoCIStringSumOverloads
+
+inline String operator + (const char *lhs, const String &rhs) {
+  String ret(lhs);
+  ret += rhs;
+  return ret;
+}
+
+inline String operator + (const char *lhs, String &&rhs) {
+  rhs.insert(0, lhs);
+  return std::move(rhs);
+}
+
 inline std::ostream& operator << ( std::ostream& out, const String& bs ) {
   out << bs.c_str();
   return out;
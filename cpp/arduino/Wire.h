@@ -37,6 +37,8 @@
 #include "Stream.h"
 #include <cassert>
 #include <deque>
+#include <utility>
+#include <vector>
 using std::deque;
 
 const size_t SLAVE_COUNT = 128;
@@ -90,6 +92,35 @@ public:
     return &slaves[address].mosiBuffer;
   }
 
+  // a copy of the mock's state, as captured by GODMODE()->snapshot().  only slaves holding data are kept
+  struct Mocks {
+    bool didBegin;
+    int in;   // slave index, or -1
+    int out;  // slave index, or -1
+    std::vector<std::pair<uint8_t, wireData_t> > slaves;
+  };
+
+  void saveMocks(Mocks& m) const {
+    m.didBegin = _didBegin;
+    m.in = in ? in - slaves : -1;
+    m.out = out ? out - slaves : -1;
+    m.slaves.clear();
+    for (size_t i = 0; i < SLAVE_COUNT; ++i) {
+      const wireData_t& d = slaves[i];
+      if (d.misoSize || d.mosiSize || !d.misoBuffer.empty() || !d.mosiBuffer.empty()) {
+        m.slaves.push_back(std::make_pair((uint8_t)i, d));
+      }
+    }
+  }
+
+  void restoreMocks(const Mocks& m) {
+    resetMocks();
+    _didBegin = m.didBegin;
+    in = m.in < 0 ? nullptr : &slaves[m.in];
+    out = m.out < 0 ? nullptr : &slaves[m.out];
+    for (unsigned int i = 0; i < m.slaves.size(); ++i) slaves[m.slaves[i].first] = m.slaves[i].second;
+  }
+
 
   //////////////////////////////////////////////////////////////////////////////////////////////
   // mock implementation
@@ -255,4 +286,4 @@ public:
 
 };
 
-extern TwoWire Wire;
+extern thread_local TwoWire Wire;
@@ -100,7 +100,7 @@
 
 // hardware mocks
 // this set of macros is all we need from the sfr file
-extern volatile uint8_t __ARDUINO_CI_SFR_MOCK[1024];
+extern thread_local volatile uint8_t __ARDUINO_CI_SFR_MOCK[1024];
 #define _SFR_IO8(io_addr) (*(volatile uint8_t *)(__ARDUINO_CI_SFR_MOCK + io_addr))
 #define _SFR_IO16(io_addr) (*(volatile uint16_t *)(__ARDUINO_CI_SFR_MOCK + io_addr))
 #define _SFR_MEM8(io_addr) (*(volatile uint8_t *)(__ARDUINO_CI_SFR_MOCK + io_addr))
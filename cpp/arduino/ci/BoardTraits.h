@@ -0,0 +1,141 @@
+#pragma once
+
+// Compile-time description of the board being mocked.
+//
+// The board is identified from the same defines that misc/default.yml sets
+// for each platform, and the figures come from the respective Arduino cores.
+// Any of the macros below can be overridden by defining it in the platform's
+// gcc defines; in particular MOCK_PINS_COUNT=256 restores the old pin space.
+
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__)
+  #define _BOARD_PINS          20
+  #define _BOARD_ANALOG_INPUTS 6
+  #define _BOARD_SRAM_SIZE     2048UL
+  #define _BOARD_FLASH_SIZE    32768UL
+  #define _BOARD_F_CPU         16000000UL
+#elif defined(__AVR_ATmega168__)
+  #define _BOARD_PINS          20
+  #define _BOARD_ANALOG_INPUTS 6
+  #define _BOARD_SRAM_SIZE     1024UL
+  #define _BOARD_FLASH_SIZE    16384UL
+  #define _BOARD_F_CPU         16000000UL
+#elif defined(__AVR_ATmega32U4__)
+  #define _BOARD_PINS          31
+  #define _BOARD_ANALOG_INPUTS 12
+  #define _BOARD_SRAM_SIZE     2560UL
+  #define _BOARD_FLASH_SIZE    32768UL
+  #define _BOARD_F_CPU         16000000UL
+#elif defined(__AVR_ATmega2560__) || defined(__AVR_ATmega1280__)
+  #define _BOARD_PINS          70
+  #define _BOARD_ANALOG_INPUTS 16
+  #define _BOARD_SRAM_SIZE     8192UL
+  #if defined(__AVR_ATmega2560__)
+    #define _BOARD_FLASH_SIZE  262144UL
+  #else
+    #define _BOARD_FLASH_SIZE  131072UL
+  #endif
+  #define _BOARD_F_CPU         16000000UL
+#elif defined(__AVR_ATtiny85__)
+  #define _BOARD_PINS          6
+  #define _BOARD_ANALOG_INPUTS 4
+  #define _BOARD_SRAM_SIZE     512UL
+  #define _BOARD_FLASH_SIZE    8192UL
+  #define _BOARD_F_CPU         8000000UL
+#elif defined(__AVR_ATmega4809__)
+  #define _BOARD_PINS          22
+  #define _BOARD_ANALOG_INPUTS 14
+  #define _BOARD_SRAM_SIZE     6144UL
+  #define _BOARD_FLASH_SIZE    49152UL
+  #define _BOARD_F_CPU         16000000UL
+#elif defined(__SAM3X8E__)
+  #define _BOARD_PINS          79
+  #define _BOARD_ANALOG_INPUTS 12
+  #define _BOARD_SRAM_SIZE     98304UL
+  #define _BOARD_FLASH_SIZE    524288UL
+  #define _BOARD_F_CPU         84000000UL
+#elif defined(__SAMD21G18A__)
+  #define _BOARD_PINS          26
+  #define _BOARD_ANALOG_INPUTS 6
+  #define _BOARD_SRAM_SIZE     32768UL
+  #define _BOARD_FLASH_SIZE    262144UL
+  #define _BOARD_F_CPU         48000000UL
+#elif defined(__SAMD51__)
+  #define _BOARD_PINS          40
+  #define _BOARD_ANALOG_INPUTS 6
+  #define _BOARD_SRAM_SIZE     196608UL
+  #define _BOARD_FLASH_SIZE    524288UL
+  #define _BOARD_F_CPU         120000000UL
+#elif defined(ESP32)
+  #define _BOARD_PINS          40
+  #define _BOARD_ANALOG_INPUTS 18
+  #define _BOARD_SRAM_SIZE     327680UL
+  #define _BOARD_FLASH_SIZE    4194304UL
+  #define _BOARD_F_CPU         240000000UL
+#elif defined(ESP8266)
+  #define _BOARD_PINS          17
+  #define _BOARD_ANALOG_INPUTS 1
+  #define _BOARD_SRAM_SIZE     81920UL
+  #define _BOARD_FLASH_SIZE    4194304UL
+  #define _BOARD_F_CPU         80000000UL
+#else
+  // unknown board: allow every pin number that fits in a uint8_t.  0 means unknown.
+  #define _BOARD_PINS          256
+  #define _BOARD_ANALOG_INPUTS 16
+  #define _BOARD_SRAM_SIZE     0UL
+  #define _BOARD_FLASH_SIZE    0UL
+  #define _BOARD_F_CPU         1000000UL
+#endif
+
+// number of pins (and interrupts, and memory-mapped ports) that are mocked
+#if !defined(MOCK_PINS_COUNT)
+  #define MOCK_PINS_COUNT _BOARD_PINS
+#endif
+
+#if !defined(F_CPU)
+  #define F_CPU _BOARD_F_CPU
+#endif
+
+#if (!defined NUM_SERIAL_PORTS)
+  #if defined(UBRR3H)
+    #define NUM_SERIAL_PORTS 4
+  #elif defined(UBRR2H)
+    #define NUM_SERIAL_PORTS 3
+  #elif defined(UBRR1H)
+    #define NUM_SERIAL_PORTS 2
+  #elif defined(UBRRH) || defined(UBRR0H)
+    #define NUM_SERIAL_PORTS 1
+  #else
+    #define NUM_SERIAL_PORTS 0
+  #endif
+#endif
+
+// different EEPROM implementations have different macros that leak out
+#if !defined(EEPROM_SIZE) && defined(E2END) && (E2END)
+  // public value indicates that feature is available
+  #define EEPROM_SIZE (E2END + 1)
+  // local array size
+  #define _EEPROM_SIZE EEPROM_SIZE
+#else
+  // feature is not available but we want to have the array so other code compiles
+  #define _EEPROM_SIZE (0)
+#endif
+
+// the same figures, for use in C++ expressions (including static_assert)
+struct ArduinoCIBoardTraits {
+  static constexpr unsigned int pins() { return MOCK_PINS_COUNT; }
+  static constexpr unsigned int analogInputs() { return _BOARD_ANALOG_INPUTS; }
+  static constexpr unsigned int serialPorts() { return NUM_SERIAL_PORTS; }
+  static constexpr unsigned long eepromSize() { return _EEPROM_SIZE; }
+  static constexpr unsigned long sramSize() { return _BOARD_SRAM_SIZE; }
+  static constexpr unsigned long flashSize() { return _BOARD_FLASH_SIZE; }
+  static constexpr unsigned long cpuFrequency() { return F_CPU; }
+  static constexpr bool isPin(unsigned int pin) { return pin < MOCK_PINS_COUNT; }
+};
+
+// the board's named pins had better exist
+#if defined(LED_BUILTIN)
+  static_assert(ArduinoCIBoardTraits::isPin(LED_BUILTIN), "LED_BUILTIN is outside the mocked pin range");
+#endif
+#if defined(A0)
+  static_assert(ArduinoCIBoardTraits::isPin(A0), "A0 is outside the mocked pin range");
+#endif
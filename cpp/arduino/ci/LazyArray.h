@@ -0,0 +1,198 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+// A fixed-size array whose elements are allocated and reset lazily.
+//
+// Elements are allocated the first time they are accessed, so an element that
+// is never used costs only its entry in a compact index.
+//
+// reset() is O(1): it bumps a generation counter.  Each element remembers the
+// generation it was last reset in, and is brought up to date by the resetter
+// the first time it is accessed afterward.  So the cost of resetting scales
+// with the number of elements actually used, not the size of the array.
+//
+// snapshot() saves the contents cheaply, and restore() puts them back.  Elements never move, so
+// references to them stay good across both.  A snapshot shares each element's contents with the
+// array until the array next accesses that element, at which point the snapshot is given its own
+// copy (copy-on-write).  So taking a snapshot costs one pointer per allocated element.
+//
+// An index outside the array reaches a scratch element instead, which is reset every time it is
+// handed out: like the Arduino core with a pin the board doesn't have, writes go nowhere and
+// reads see the reset value.  at<I>() checks a constant index at compile time instead.
+//
+// R is a functor type with `void operator()(V&) const`, copied in by reset().
+template <typename V, unsigned int N, typename R>
+class ArduinoCILazyArray {
+  private:
+    struct Slot;
+
+    // an element's contents as a snapshot saw them.  while source is set, they are still that
+    // live element's, unchanged since
+    struct Image {
+      V item;
+      unsigned long generation;
+      const Slot* source;
+
+      Image() : item(), generation(0), source(nullptr) { }
+      inline const V& contents() const { return source ? source->item : item; }
+      inline unsigned long contentsGeneration() const { return source ? source->generation : generation; }
+    };
+
+    struct Slot {
+      V item;
+      unsigned long generation;
+      unsigned int index;
+      std::shared_ptr<Image> image;  // shared with snapshots taken since this was last accessed
+
+      Slot(unsigned int i) : item(), generation(0), index(i), image() { }
+    };
+
+    // boards without a feature still get a (tiny) index, so other code compiles
+    static const unsigned int STORAGE = N ? N : 1;
+    static const unsigned int SCRATCH = STORAGE;  // where out-of-range indexes go
+
+    unsigned short mIndex[STORAGE + 1];  // 0 means unallocated, otherwise 1 + position in mSlots
+    std::vector<Slot*> mSlots;
+    unsigned long mCurrent;
+    R mResetter;
+
+    void init() {
+      mCurrent = 1;
+      for (unsigned int i = 0; i <= STORAGE; ++i) mIndex[i] = 0;
+    }
+
+    Slot* slotFor(unsigned int i) {
+      if (mIndex[i] == 0) {
+        mSlots.push_back(new Slot(i));
+        mIndex[i] = mSlots.size();
+      }
+      return mSlots[mIndex[i] - 1];
+    }
+
+    // about to change an element: give snapshots still sharing it their own copy
+    static void detach(Slot* s) {
+      if (!s->image) return;
+      if (s->image->source == s) {
+        s->image->item = s->item;
+        s->image->generation = s->generation;
+        s->image->source = nullptr;
+      }
+      s->image.reset();
+    }
+
+  public:
+    // the saved contents of an array; see snapshot()
+    class Snapshot {
+      private:
+        friend class ArduinoCILazyArray;
+        std::vector<std::pair<unsigned int, std::shared_ptr<const Image> > > mImages;  // allocated elements, by index
+        unsigned long mCurrent;
+        R mResetter;
+
+      public:
+        Snapshot() : mImages(), mCurrent(1), mResetter() { }
+    };
+
+    ArduinoCILazyArray() : mResetter() { init(); }
+
+    // elements stay where they are, so the array isn't copied; see snapshot()
+    ArduinoCILazyArray(const ArduinoCILazyArray&) = delete;
+    ArduinoCILazyArray& operator=(const ArduinoCILazyArray&) = delete;
+
+    ~ArduinoCILazyArray() {
+      for (unsigned int i = 0; i < mSlots.size(); ++i) {
+        detach(mSlots[i]);
+        delete mSlots[i];
+      }
+    }
+
+    // save the contents of every element, in O(allocated elements)
+    Snapshot snapshot() const {
+      Snapshot ret;
+      ret.mCurrent = mCurrent;
+      ret.mResetter = mResetter;
+      ret.mImages.reserve(mSlots.size());
+      for (unsigned int i = 0; i < mSlots.size(); ++i) {
+        Slot* s = mSlots[i];
+        if (s->index == SCRATCH) continue;
+        if (!s->image) {
+          s->image = std::make_shared<Image>();
+          s->image->source = s;
+        }
+        ret.mImages.push_back(std::make_pair(s->index, std::shared_ptr<const Image>(s->image)));
+      }
+      return ret;
+    }
+
+    // put back the contents saved in a snapshot, assigning them to the elements in place.  the
+    // snapshot is unchanged.  elements it didn't have are reset when next accessed
+    void restore(const Snapshot& snap) {
+      mCurrent = snap.mCurrent;
+      mResetter = snap.mResetter;
+      std::vector<bool> restored(STORAGE, false);
+      for (unsigned int i = 0; i < snap.mImages.size(); ++i) {
+        const Image* image = snap.mImages[i].second.get();
+        Slot* s = slotFor(snap.mImages[i].first);
+        restored[s->index] = true;
+        if (image->source == s) continue;  // untouched since the snapshot
+        detach(s);
+        s->item = image->contents();
+        s->generation = image->contentsGeneration();
+      }
+      for (unsigned int i = 0; i < mSlots.size(); ++i) {
+        Slot* s = mSlots[i];
+        if (s->index == SCRATCH || restored[s->index]) continue;
+        detach(s);
+        s->generation = 0;
+      }
+    }
+
+    // access an element, allocating it and/or resetting it first as needed.  an index outside
+    // the array gets the freshly reset scratch element
+    V& operator[](unsigned int i) {
+      bool inRange = i < N;
+      if (!inRange) i = SCRATCH;
+      Slot* s = slotFor(i);
+      detach(s);
+      if (s->generation != mCurrent || !inRange) {
+        mResetter(s->item);
+        s->generation = mCurrent;
+      }
+      return s->item;
+    }
+
+    // access an element whose index is a constant, failing to compile if it is out of range
+    template <unsigned int I>
+    V& at() {
+      static_assert(I < N, "index is outside the array (for pins, the mocked board doesn't have that pin)");
+      return (*this)[I];
+    }
+
+    // whether an element has been accessed since the last reset
+    bool touched(unsigned int i) const { return i < N && mIndex[i] && mSlots[mIndex[i] - 1]->generation == mCurrent; }
+
+    // whether an element has ever been accessed (and so holds memory)
+    bool allocated(unsigned int i) const { return i < N && mIndex[i] != 0; }
+
+    // number of elements that hold memory, not counting the scratch element
+    inline unsigned int allocatedCount() const { return mSlots.size() - (mIndex[SCRATCH] ? 1 : 0); }
+
+    // whether a snapshot still shares an element's contents
+    bool shared(unsigned int i) const {
+      return i < N && mIndex[i] && mSlots[mIndex[i] - 1]->image && mSlots[mIndex[i] - 1]->image->source;
+    }
+
+    // mark every element stale, to be reset with the given resetter
+    void reset(const R& resetter) {
+      mResetter = resetter;
+      ++mCurrent;
+    }
+
+    // mark every element stale, to be reset with the current resetter
+    void reset() { ++mCurrent; }
+
+    inline unsigned int size() const { return N; }
+};
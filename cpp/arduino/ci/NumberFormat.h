@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cmath>
+#include <stdio.h>
+#include <string.h>
+
+// work around some portability issues
+#if defined(__clang__)
+  #define ARDUINOCI_ISNAN isnan
+  #define ARDUINOCI_ISINF isinf
+#elif defined(__GNUC__) || defined(__GNUG__)
+  #define ARDUINOCI_ISNAN std::isnan
+  #define ARDUINOCI_ISINF std::isinf
+#elif defined(_MSC_VER)
+  // TODO: no idea
+  #define ARDUINOCI_ISNAN ::isnan
+  #define ARDUINOCI_ISINF ::isinf
+#else
+  #define ARDUINOCI_ISNAN ::isnan
+  #define ARDUINOCI_ISINF ::isinf
+#endif
+
+// Number to text conversion, shared by String, Print and the stdlib extensions.
+//
+// Everything is written into a caller's stack buffer; nothing allocates.  Integers are
+// converted two digits per step and match the AVR core character for character.  Floats are
+// all converted by Print::printFloat()'s arithmetic: add half of the last decimal place, then
+// truncate digit by digit.
+//   - String and itoa()/ltoa()/ultoa() follow avr-libc: lowercase digits, and a minus sign only
+//     in base 10 (other bases show the two's complement)
+//   - Print follows Print::printNumber() and printFloat(): uppercase digits, "nan", "inf" and "ovf"
+//   - String(double) and dtostrf() have avr-libc dtostrf()'s layout, padded to the requested
+//     width, but printFloat()'s rounding; avr-libc rounds in its own float engine, so a value
+//     that lands on a digit-carry boundary can come out one in the last place differently
+// (long and double have the host's widths, so they also hold more than on AVR)
+class ArduinoCINumberFormat {
+  private:
+    static inline char digitChar(unsigned int d, bool upper) {
+      return d < 10 ? '0' + d : (upper ? 'A' : 'a') + d - 10;
+    }
+
+    // "00" through "99"
+    static inline const char* decimalPairs() {
+      return "0001020304050607080910111213141516171819"
+             "2021222324252627282930313233343536373839"
+             "4041424344454647484950515253545556575859"
+             "6061626364656667686970717273747576777879"
+             "8081828384858687888990919293949596979899";
+    }
+
+    // the digits of a value below 1, after number has been rounded; as printFloat does it
+    static char* fraction(double remainder, unsigned char digits, char* out) {
+      while (digits-- > 0) {
+        remainder *= 10.0;
+        unsigned int d = (unsigned int)remainder;
+        *out++ = '0' + d;
+        remainder -= d;
+      }
+      return out;
+    }
+
+    static char* libcInteger(long long value, bool isSigned, unsigned long long asUnsigned, unsigned int base, char* end) {
+      if (base < 2 || base > 36) return end;
+      if (isSigned && base == 10 && value < 0) {
+        end = digits(0ULL - (unsigned long long)value, 10, end, false);
+        *--end = '-';
+        return end;
+      }
+      return digits(asUnsigned, base, end, false);
+    }
+
+  public:
+    // enough for any 64-bit integer in base 2 with a sign and terminator
+    static const unsigned int INTEGER_CHARS = 66;
+
+    // enough for any double with up to 255 decimal places, a sign and terminator, at any width
+    static const unsigned int FLOAT_CHARS = 640;
+
+    // write the digits of value backward so that they end just before end; returns the first.
+    // base must be at least 2
+    static char* digits(unsigned long long value, unsigned int base, char* end, bool upper) {
+      if (base == 10) {
+        while (value >= 100) {
+          unsigned int pair = (unsigned int)(value % 100);
+          value /= 100;
+          end -= 2;
+          memcpy(end, decimalPairs() + 2 * pair, 2);
+        }
+        if (value >= 10) {
+          end -= 2;
+          memcpy(end, decimalPairs() + 2 * value, 2);
+        } else {
+          *--end = '0' + (char)value;
+        }
+        return end;
+      }
+
+      if ((base & (base - 1)) == 0) {
+        unsigned int shift = 0;
+        while ((1U << shift) < base) ++shift;
+        do {
+          *--end = digitChar((unsigned int)(value & (base - 1)), upper);
+          value >>= shift;
+        } while (value);
+        return end;
+      }
+
+      // any other base: two digits per division by base squared
+      unsigned long long square = (unsigned long long)base * base;
+      while (value >= square) {
+        unsigned int pair = (unsigned int)(value % square);
+        value /= square;
+        *--end = digitChar(pair % base, upper);
+        *--end = digitChar(pair / base, upper);
+      }
+      do {
+        *--end = digitChar((unsigned int)(value % base), upper);
+        value /= base;
+      } while (value);
+      return end;
+    }
+
+    // an integer the way avr-libc's itoa() family writes it, ending just before end; returns the
+    // first character.  a base outside 2-36 gives an empty result
+    template <typename T>
+    static char* libc(T value, unsigned int base, char* end) {
+      // the unsigned counterpart of T, for the two's complement in other bases
+      T zero = 0;
+      bool isSigned = (T)(zero - 1) < zero;
+      unsigned long long asUnsigned = isSigned && value < zero
+        ? (unsigned long long)value & (~0ULL >> (64 - 8 * sizeof(T)))
+        : (unsigned long long)value;
+      return libcInteger((long long)value, isSigned, asUnsigned, base, end);
+    }
+
+    // a float the way Print::printFloat() writes it.  out needs FLOAT_CHARS; returns the length
+    static size_t printFloat(double number, unsigned char decimals, char* out) {
+      const char* special = nullptr;
+      if (ARDUINOCI_ISNAN(number)) special = "nan";
+      else if (ARDUINOCI_ISINF(number)) special = "inf";
+      else if (number > 4294967040.0 || number < -4294967040.0) special = "ovf";  // the core's limit
+      if (special) {
+        memcpy(out, special, 3);
+        return 3;
+      }
+
+      char* p = out;
+      if (number < 0.0) {
+        *p++ = '-';
+        number = -number;
+      }
+
+      // round correctly so that print(1.999, 2) prints as "2.00"
+      double rounding = 0.5;
+      for (unsigned char i = 0; i < decimals; ++i) rounding /= 10.0;
+      number += rounding;
+
+      unsigned long intPart = (unsigned long)number;
+      char intBuf[INTEGER_CHARS];
+      char* first = digits(intPart, 10, intBuf + sizeof(intBuf), true);
+      size_t n = intBuf + sizeof(intBuf) - first;
+      memcpy(p, first, n);
+      p += n;
+      if (decimals > 0) *p++ = '.';
+      return fraction(number - (double)intPart, decimals, p) - out;
+    }
+
+    // a float laid out as avr-libc's dtostrf() does it, rounded as printFloat() does: at least
+    // |width| characters, right-aligned (left-aligned for a negative width).  out needs
+    // FLOAT_CHARS; returns the length
+    static size_t dtostrf(double value, signed char width, unsigned char decimals, char* out) {
+      char body[FLOAT_CHARS];
+      char* p = body;
+      if (std::signbit(value)) *p++ = '-';
+      double magnitude = std::fabs(value);
+
+      if (ARDUINOCI_ISNAN(value) || ARDUINOCI_ISINF(value)) {
+        memcpy(p, ARDUINOCI_ISNAN(value) ? "nan" : "inf", 3);
+        p += 3;
+      } else if (magnitude >= 18446744073709551616.0) {
+        // beyond 64 bits of integer part, which no AVR float reaches; let the host print it
+        p += snprintf(p, body + sizeof(body) - p, "%.*f", decimals, magnitude);
+      } else {
+        double rounding = 0.5;
+        for (unsigned char i = 0; i < decimals; ++i) rounding /= 10.0;
+        magnitude += rounding;
+        unsigned long long intPart = magnitude >= 18446744073709551615.0 ? ~0ULL : (unsigned long long)magnitude;
+        char intBuf[INTEGER_CHARS];
+        char* first = digits(intPart, 10, intBuf + sizeof(intBuf), false);
+        size_t n = intBuf + sizeof(intBuf) - first;
+        memcpy(p, first, n);
+        p += n;
+        if (decimals > 0) *p++ = '.';
+        p = fraction(magnitude - (double)intPart, decimals, p);
+      }
+
+      size_t len = p - body;
+      size_t field = width < 0 ? -(int)width : width;
+      size_t pad = field > len ? field - len : 0;
+      if (width < 0) {
+        memcpy(out, body, len);
+        memset(out + len, ' ', pad);
+      } else {
+        memset(out, ' ', pad);
+        memcpy(out + pad, body, len);
+      }
+      out[len + pad] = '\0';
+      return len + pad;
+    }
+};
@@ -24,6 +24,10 @@ class DataStreamObserver {
     // functions that are up to the implementer to provide.
     virtual void onBit(bool aBit) {}
     virtual void onByte(unsigned char aByte) {}
+    // a run of bytes written at once.  by default, each is handed to onByte
+    virtual void onBytes(const unsigned char* bytes, size_t count) {
+      for (size_t i = 0; i < count; ++i) onByte(bytes[i]);
+    }
     virtual String observerName() const = 0;
 
   public:
@@ -42,6 +46,11 @@ class DataStreamObserver {
       onByte(aByte);
     }
 
+    // entry point for handler of a run of bytes
+    void handleBytes(const unsigned char* bytes, size_t count) {
+      onBytes(bytes, count);
+    }
+
     // entry point for bit-related handler
     void handleBit(bool aBit) {
       onBit(aBit);
@@ -75,6 +84,8 @@ class ObservableDataStream
     ArduinoCITable<String, DataStreamObserver*> mObservers;
     bool          mAdvertisingBit;
     unsigned char mAdvertisingByte;
+    const unsigned char* mAdvertisingBytes;
+    size_t        mAdvertisingCount;
 
   protected:
     // to allow both member and non-member functions to be called, we need to trick the compiler
@@ -89,6 +100,10 @@ class ObservableDataStream
       val->handleByte(that->mAdvertisingByte);
     }
 
+    static void workAdvertiseBytes(ObservableDataStream* that, String _, DataStreamObserver* val) {
+      val->handleBytes(that->mAdvertisingBytes, that->mAdvertisingCount);
+    }
+
     // advertise functions allow the data stream to publish to observers
 
     // update all observers with a byte value
@@ -98,6 +113,14 @@ class ObservableDataStream
       mObservers.iterate(workAdvertiseByte, this);
     }
 
+    // update all observers with a run of bytes, in one notification
+    void advertiseBytes(const unsigned char* bytes, size_t count) {
+      if (mObservers.size() == 0 || count == 0) return;
+      mAdvertisingBytes = bytes;
+      mAdvertisingCount = count;
+      mObservers.iterate(workAdvertiseBytes, this);
+    }
+
     // update all observers with a byte value
     // build up a byte
     // if requested, advertise the byte
@@ -111,6 +134,8 @@ class ObservableDataStream
     ObservableDataStream() : mObservers() {
       mAdvertisingBit  = false; // we'll re-init on demand though
       mAdvertisingByte = 0x07;  // we'll re-init on demand though
+      mAdvertisingBytes = nullptr;
+      mAdvertisingCount = 0;
     }
 
     virtual ~ObservableDataStream() {}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// A queue of callbacks to be run at given points in (virtual) time.
+//
+// Events are kept in a binary heap ordered by time, then by the order in which
+// they were posted, so events due at the same moment run first-come first-served.
+// Posting and taking the next due event are O(log n); cancelling is O(n).
+class ArduinoCIScheduler {
+  public:
+    typedef std::function<void(void)> Callback;
+
+    struct Event {
+      unsigned long micros;
+      unsigned long id;
+      Callback callback;
+      void (*function)(void*, unsigned long);  // alternative to callback, for posting without allocation
+      void* context;
+      std::shared_ptr<void> owner;  // keeps context alive for as long as any copy of the event
+
+      Event() : micros(0), id(0), callback(), function(nullptr), context(nullptr), owner() { }
+      Event(unsigned long t, unsigned long i, const Callback& c) : micros(t), id(i), callback(c), function(nullptr), context(nullptr), owner() { }
+      Event(unsigned long t, unsigned long i, void (*f)(void*, unsigned long), void* ctx, const std::shared_ptr<void>& o)
+        : micros(t), id(i), callback(), function(f), context(ctx), owner(o) { }
+
+      void run() {
+        if (function) {
+          function(context, micros);
+        } else {
+          callback();
+        }
+      }
+    };
+
+  private:
+    // heap order: the earliest event (lowest id among equals) sits at the front
+    struct Later {
+      bool operator()(const Event& a, const Event& b) const {
+        return a.micros != b.micros ? a.micros > b.micros : a.id > b.id;
+      }
+    };
+
+    std::vector<Event> mHeap;
+    unsigned long mNextId;
+
+  public:
+    ArduinoCIScheduler() : mNextId(1) { }
+
+    inline unsigned long size() const { return mHeap.size(); }
+    inline bool empty() const { return mHeap.empty(); }
+
+    // the time of the earliest event.  only meaningful if !empty()
+    inline unsigned long nextMicros() const { return mHeap.empty() ? 0 : mHeap.front().micros; }
+
+    // add a callback to run at the given time, returning an id that can cancel it
+    unsigned long post(unsigned long micros, const Callback& callback) {
+      unsigned long id = mNextId++;
+      mHeap.push_back(Event(micros, id, callback));
+      std::push_heap(mHeap.begin(), mHeap.end(), Later());
+      return id;
+    }
+
+    // add a function to run at the given time, called with a context argument and the time it
+    // was due.  unlike a Callback this never allocates (beyond the heap's own growth), for code
+    // that posts an event per sample.
+    // if owner is given, the event shares ownership of the context, so that copies of the queue
+    // (see GodmodeState::snapshot) can't outlive it
+    unsigned long post(unsigned long micros, void (*function)(void*, unsigned long), void* context, const std::shared_ptr<void>& owner = nullptr) {
+      unsigned long id = mNextId++;
+      mHeap.push_back(Event(micros, id, function, context, owner));
+      std::push_heap(mHeap.begin(), mHeap.end(), Later());
+      return id;
+    }
+
+    // remove a pending event.  false if it already ran or never existed
+    bool cancel(unsigned long id) {
+      for (unsigned long i = 0; i < mHeap.size(); ++i) {
+        if (mHeap[i].id != id) continue;
+        mHeap.erase(mHeap.begin() + i);
+        std::make_heap(mHeap.begin(), mHeap.end(), Later());
+        return true;
+      }
+      return false;
+    }
+
+    // take the earliest event if it is due at or before the given time
+    bool popDue(unsigned long micros, Event& out) {
+      if (mHeap.empty() || mHeap.front().micros > micros) return false;
+      std::pop_heap(mHeap.begin(), mHeap.end(), Later());
+      out = std::move(mHeap.back());
+      mHeap.pop_back();
+      return true;
+    }
+
+    void clear() { mHeap.clear(); }
+
+    // take the events of another queue, keeping ids unique: ids already handed out by this
+    // queue are never handed out again, so cancelling a stale id can't hit a newer event
+    void assignEvents(const ArduinoCIScheduler& other) {
+      unsigned long nextId = std::max(mNextId, other.mNextId);
+      *this = other;
+      mNextId = nextId;
+    }
+};
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include "../ArduinoDefines.h"
+
+// Signal generators: functions of (virtual) time in microseconds, for PinHistory::setGenerator().
+//
+// Each one holds only its parameters, so a signal of any length costs the same few bytes,
+// and each reading is computed on the spot.  They return long, which the pin converts to its
+// own type (for digital pins, nonzero is HIGH).
+
+// offset + amplitude * sin(2 pi (t + phase) / period), rounded
+class SineSignal {
+  private:
+    double mOffset;
+    double mAmplitude;
+    double mRadiansPerMicro;
+    unsigned long mPeriod;
+    unsigned long mPhase;
+
+  public:
+    SineSignal(double offset, double amplitude, unsigned long periodMicros, unsigned long phaseMicros = 0)
+      : mOffset(offset), mAmplitude(amplitude), mRadiansPerMicro(6.283185307179586 / (periodMicros ? periodMicros : 1)),
+        mPeriod(periodMicros ? periodMicros : 1), mPhase(phaseMicros) { }
+
+    long operator()(unsigned long micros) const {
+      // reduce first, so precision doesn't suffer a week into the signal
+      return lround(mOffset + mAmplitude * sin(((micros + mPhase) % mPeriod) * mRadiansPerMicro));
+    }
+};
+
+// high for the first highMicros of each period, low for the rest
+class SquareSignal {
+  private:
+    long mLow;
+    long mHigh;
+    unsigned long mPeriod;
+    unsigned long mHighTime;
+
+  public:
+    SquareSignal(long low, long high, unsigned long periodMicros, unsigned long highMicros)
+      : mLow(low), mHigh(high), mPeriod(periodMicros ? periodMicros : 1), mHighTime(highMicros) { }
+
+    long operator()(unsigned long micros) const { return (micros % mPeriod) < mHighTime ? mHigh : mLow; }
+
+    // the first time after a given one that the signal changes, so that a pin can find its edges
+    // without sampling.  false if it never changes (or not before the clock wraps around)
+    bool nextChange(unsigned long after, unsigned long& at) const {
+      if (mHighTime == 0 || mHighTime >= mPeriod || mHigh == mLow) return false;
+      unsigned long phase = after % mPeriod;
+      unsigned long next = after - phase + (phase < mHighTime ? mHighTime : mPeriod);
+      if (next <= after) return false;
+      at = next;
+      return true;
+    }
+};
+
+// a digital clock: HIGH for the first half of each period
+class ClockSignal : public SquareSignal {
+  public:
+    ClockSignal(unsigned long periodMicros) : SquareSignal(LOW, HIGH, periodMicros, periodMicros / 2) { }
+};
+
+// what analogWrite(pin, duty) puts on a pin: HIGH for duty/255 of each period (490Hz by default)
+class PWMSignal : public SquareSignal {
+  public:
+    PWMSignal(uint8_t duty, unsigned long periodMicros = 2040)
+      : SquareSignal(LOW, HIGH, periodMicros, (unsigned long)duty * periodMicros / 255) { }
+};
+
+// a sawtooth: rises linearly from one value toward another over each period, then starts over
+class RampSignal {
+  private:
+    long mFrom;
+    long mTo;
+    unsigned long mPeriod;
+
+  public:
+    RampSignal(long from, long to, unsigned long periodMicros)
+      : mFrom(from), mTo(to), mPeriod(periodMicros ? periodMicros : 1) { }
+
+    long operator()(unsigned long micros) const {
+      return mFrom + (long)((double)(mTo - mFrom) * (micros % mPeriod) / mPeriod);
+    }
+};
+
+// uniform noise between min and max inclusive, holding each value for a while.
+// the value is a hash of the seed and the time, so it needs no state and any time can be
+// read in any order: the same seed gives the same signal
+class NoiseSignal {
+  private:
+    long mMin;
+    unsigned long mSpan;
+    unsigned long mHold;
+    uint64_t mSeed;
+
+  public:
+    // min and max may come in either order.  the span is worked out unsigned, so the full range
+    // of long (where it wraps to 0) is fine too
+    NoiseSignal(long min, long max, unsigned long seed = 1, unsigned long holdMicros = 1)
+      : mMin(min < max ? min : max),
+        mSpan((unsigned long)(min < max ? max : min) - (unsigned long)(min < max ? min : max) + 1),
+        mHold(holdMicros ? holdMicros : 1),
+        mSeed(seed) { }
+
+    long operator()(unsigned long micros) const {
+      // splitmix64 finalizer
+      uint64_t z = mSeed + (uint64_t)(micros / mHold) * 0x9E3779B97F4A7C15ULL;
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+      z ^= z >> 31;
+      unsigned long offset = mSpan ? (unsigned long)(z % mSpan) : (unsigned long)z;
+      return (long)((unsigned long)mMin + offset);
+    }
+};
@@ -0,0 +1,263 @@
+#pragma once
+
+#include <string.h>
+#include <algorithm>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+#include "../WString.h"
+
+// The input side of a mocked stream: bytes waiting to be read, with a consume cursor.
+//
+// Reading advances the cursor instead of shifting the remaining bytes, and the space in
+// front of the cursor is reclaimed only when appending would otherwise have to grow the
+// storage and at least half of it is dead.  So reading or writing a byte is amortized O(1),
+// and the unread bytes are always one contiguous run that can be scanned or copied in place.
+//
+// It offers String's read API (c_str(), indexOf(), substring() and so on) and compares with
+// Strings and C strings, so tests can keep treating GODMODE()->serialPort[0].dataIn as the
+// String it used to be; toString() gives a copy where a real String is needed.
+class ArduinoCIStreamBuffer {
+  private:
+    std::vector<char> mBytes;
+    size_t mHead;  // first unread byte
+    size_t mTail;  // one past the last byte
+
+    // make room to append n bytes, and the terminator after them
+    void reserveFor(size_t n) {
+      size_t len = length();
+      ++n;
+      if (mTail + n <= mBytes.size()) return;
+      if (mHead >= len && len + n <= mBytes.size()) {
+        memmove(mBytes.data(), mBytes.data() + mHead, len);
+      } else {
+        std::vector<char> next(std::max(std::max(mBytes.size() * 2, len + n), (size_t)16));
+        if (len) memcpy(next.data(), mBytes.data() + mHead, len);
+        mBytes.swap(next);
+      }
+      mHead = 0;
+      mTail = len;
+    }
+
+  public:
+    static const size_t npos = String::npos;
+
+    ArduinoCIStreamBuffer() : mBytes(), mHead(0), mTail(0) { }
+    ArduinoCIStreamBuffer(const char* s) : mBytes(), mHead(0), mTail(0) { append(s, strlen(s)); }
+    explicit ArduinoCIStreamBuffer(const String& s) : mBytes(), mHead(0), mTail(0) { append(s.data(), s.length()); }
+    ArduinoCIStreamBuffer(const ArduinoCIStreamBuffer& b) : mBytes(), mHead(0), mTail(0) { append(b.data(), b.length()); }
+
+    ArduinoCIStreamBuffer& operator=(const ArduinoCIStreamBuffer& b) {
+      if (this != &b) assign(b.data(), b.length());
+      return *this;
+    }
+    ArduinoCIStreamBuffer& operator=(const char* s) { assign(s, strlen(s)); return *this; }
+    ArduinoCIStreamBuffer& operator=(const String& s) { assign(s.data(), s.length()); return *this; }
+
+    inline size_t length() const { return mTail - mHead; }
+    inline size_t size() const { return length(); }
+    inline bool empty() const { return mTail == mHead; }
+
+    // the unread bytes, contiguous and null-terminated.  valid until the next append
+    inline const char* data() const { return mBytes.empty() ? "" : mBytes.data() + mHead; }
+    inline const char* c_str() const { return data(); }
+
+    inline char operator[](size_t i) const { return data()[i]; }
+    inline char& operator[](size_t i) { return mBytes[mHead + i]; }
+
+    void clear() {
+      mHead = mTail = 0;
+      if (!mBytes.empty()) mBytes[0] = '\0';
+    }
+
+    // discard up to n unread bytes
+    void consume(size_t n) {
+      mHead += std::min(n, length());
+      if (mHead == mTail) clear();
+    }
+
+    void assign(const char* s, size_t n) {
+      clear();
+      append(s, n);
+    }
+
+    void append(const char* s, size_t n) {
+      if (n == 0) return;
+      reserveFor(n);
+      memcpy(mBytes.data() + mTail, s, n);
+      mTail += n;
+      mBytes[mTail] = '\0';
+    }
+
+    void append(char c) {
+      reserveFor(1);
+      mBytes[mTail++] = c;
+      mBytes[mTail] = '\0';
+    }
+
+    void concat(char c) { append(c); }
+    void concat(const char* s) { append(s, strlen(s)); }
+    void concat(const String& s) { append(s.data(), s.length()); }
+    ArduinoCIStreamBuffer& operator+=(char c) { append(c); return *this; }
+    ArduinoCIStreamBuffer& operator+=(const char* s) { concat(s); return *this; }
+    ArduinoCIStreamBuffer& operator+=(const String& s) { concat(s); return *this; }
+
+    // copy up to n unread bytes out without consuming them; returns the number copied
+    size_t copy(char* out, size_t n) const {
+      n = std::min(n, length());
+      if (n) memcpy(out, data(), n);
+      return n;
+    }
+
+    // position of a byte or byte sequence among the unread bytes, or npos
+    size_t find(char c, size_t from = 0) const {
+      if (from >= length()) return npos;
+      const char* p = (const char*)memchr(data() + from, c, length() - from);
+      return p ? p - data() : npos;
+    }
+
+    size_t find(const char* s, size_t n, size_t from = 0) const {
+      if (n == 0) return from <= length() ? from : npos;
+      const char* end = data() + length();
+      for (const char* p = data() + from; p + n <= end; ++p) {
+        p = (const char*)memchr(p, s[0], end - p);
+        if (p == nullptr || p + n > end) break;
+        if (memcmp(p, s, n) == 0) return p - data();
+      }
+      return npos;
+    }
+
+    size_t find(const String& s, size_t from = 0) const { return find(s.data(), s.length(), from); }
+
+    // the first n unread bytes (by default all of them) as a String
+    String toString(size_t n = npos) const { return String(string(data(), std::min(n, length()))); }
+    operator String() const { return toString(); }
+
+    // String's read API.  searching and comparing work in place; the rest act on a copy
+    char charAt(unsigned int index) const { return (*this)[index]; }
+    int indexOf(char ch) const                                   { return (int)find(ch); }
+    int indexOf(char ch, unsigned int fromIndex) const           { return (int)find(ch, fromIndex); }
+    int indexOf(const String &str) const                         { return (int)find(str); }
+    int indexOf(const String &str, unsigned int fromIndex) const { return (int)find(str, fromIndex); }
+    int lastIndexOf(char ch) const                                   { return toString().lastIndexOf(ch); }
+    int lastIndexOf(char ch, unsigned int fromIndex) const           { return toString().lastIndexOf(ch, fromIndex); }
+    int lastIndexOf(const String &str) const                         { return toString().lastIndexOf(str); }
+    int lastIndexOf(const String &str, unsigned int fromIndex) const { return toString().lastIndexOf(str, fromIndex); }
+    String substring(unsigned int beginIndex) const { return toString().substring(beginIndex); }
+    String substring(unsigned int beginIndex, unsigned int endIndex) const { return toString().substring(beginIndex, endIndex); }
+    unsigned char startsWith(const String &prefix) const { return find(prefix) == 0; }
+    unsigned char startsWith(const String &prefix, unsigned int offset) const { return find(prefix, offset) == offset; }
+    unsigned char endsWith(const String &suffix) const { return toString().endsWith(suffix); }
+    unsigned char equals(const String &s) const { return compareTo(s) == 0; }
+    unsigned char equals(const char *cstr) const { return compareTo(cstr) == 0; }
+    unsigned char equalsIgnoreCase(const String &s) const { return toString().equalsIgnoreCase(s); }
+    void getBytes(unsigned char *buf, unsigned int bufsize, unsigned int index = 0) const { toString().getBytes(buf, bufsize, index); }
+    void toCharArray(char *buf, unsigned int bufsize, unsigned int index = 0) const { toString().toCharArray(buf, bufsize, index); }
+    long toInt(void) const      { return toString().toInt(); }
+    float toFloat(void) const   { return toString().toFloat(); }
+    double toDouble(void) const { return toString().toDouble(); }
+
+    int compareTo(const char* s, size_t n) const {
+      size_t common = std::min(n, length());
+      int c = common ? memcmp(data(), s, common) : 0;
+      if (c) return c;
+      return length() < n ? -1 : (length() > n ? 1 : 0);
+    }
+    int compareTo(const char* s) const { return compareTo(s, strlen(s)); }
+    int compareTo(const String& s) const { return compareTo(s.data(), s.length()); }
+    int compareTo(const ArduinoCIStreamBuffer& b) const { return compareTo(b.data(), b.length()); }
+
+    bool operator==(const char* s) const { return compareTo(s) == 0; }
+    bool operator==(const String& s) const { return compareTo(s) == 0; }
+    bool operator==(const ArduinoCIStreamBuffer& b) const { return compareTo(b) == 0; }
+    bool operator!=(const char* s) const { return compareTo(s) != 0; }
+    bool operator!=(const String& s) const { return compareTo(s) != 0; }
+    bool operator!=(const ArduinoCIStreamBuffer& b) const { return compareTo(b) != 0; }
+};
+
+// What a Stream reads from: an ArduinoCIStreamBuffer, or a String as before the buffer existed.
+//
+// It is assigned and tested like the pointer Stream::mGodmodeDataIn used to be, and -> reaches
+// the input operations below, so a Stream can be pointed at either.  A String is consumed from
+// its front, at the cost of shifting what remains; the GODMODE() ports all use buffers.
+class ArduinoCIStreamInput {
+  private:
+    ArduinoCIStreamBuffer* mBuffer;
+    String* mString;
+
+  public:
+    static const size_t npos = ArduinoCIStreamBuffer::npos;
+
+    ArduinoCIStreamInput() : mBuffer(nullptr), mString(nullptr) { }
+    ArduinoCIStreamInput(std::nullptr_t) : mBuffer(nullptr), mString(nullptr) { }
+    ArduinoCIStreamInput(ArduinoCIStreamBuffer* buffer) : mBuffer(buffer), mString(nullptr) { }
+    ArduinoCIStreamInput(String* str) : mBuffer(nullptr), mString(str) { }
+
+    explicit operator bool() const { return mBuffer || mString; }
+    ArduinoCIStreamInput* operator->() { return this; }
+    const ArduinoCIStreamInput* operator->() const { return this; }
+    // the unread input, for reading only: write through buffer() or string()
+    const String operator*() const { return toString(); }
+
+    // compared and printed as the pointer it holds
+    inline const void* target() const { return mBuffer ? (const void*)mBuffer : (const void*)mString; }
+    bool operator==(const ArduinoCIStreamInput& other) const { return target() == other.target(); }
+    bool operator!=(const ArduinoCIStreamInput& other) const { return target() != other.target(); }
+    bool operator<(const ArduinoCIStreamInput& other) const { return target() < other.target(); }
+
+    // whichever of the two this reads from; the other is null
+    inline ArduinoCIStreamBuffer* buffer() const { return mBuffer; }
+    inline String* string() const { return mString; }
+
+    inline size_t length() const { return mBuffer ? mBuffer->length() : mString->length(); }
+    inline bool empty() const { return length() == 0; }
+    inline const char* data() const { return mBuffer ? mBuffer->data() : mString->c_str(); }
+
+    void clear() {
+      if (mBuffer) {
+        mBuffer->clear();
+      } else {
+        mString->clear();
+      }
+    }
+
+    // discard up to n unread bytes
+    void consume(size_t n) {
+      if (mBuffer) {
+        mBuffer->consume(n);
+      } else {
+        mString->erase(0, std::min(n, mString->length()));
+      }
+    }
+
+    void append(char c) {
+      if (mBuffer) {
+        mBuffer->append(c);
+      } else {
+        mString->push_back(c);
+      }
+    }
+
+    size_t copy(char* out, size_t n) const {
+      n = std::min(n, length());
+      if (n) memcpy(out, data(), n);
+      return n;
+    }
+
+    size_t find(char c, size_t from = 0) const { return mBuffer ? mBuffer->find(c, from) : mString->find(c, from); }
+    size_t find(const char* s, size_t n, size_t from = 0) const {
+      return mBuffer ? mBuffer->find(s, n, from) : mString->find(s, from, n);
+    }
+    size_t find(const String& s, size_t from = 0) const { return find(s.data(), s.length(), from); }
+
+    // the first n unread bytes (by default all of them) as a String
+    String toString(size_t n = npos) const {
+      return mBuffer ? mBuffer->toString(n) : String(mString->substr(0, std::min(n, mString->length())));
+    }
+};
+
+inline bool operator==(const char* s, const ArduinoCIStreamBuffer& b) { return b == s; }
+inline bool operator!=(const char* s, const ArduinoCIStreamBuffer& b) { return b != s; }
+
+inline std::ostream& operator<<(std::ostream& out, const ArduinoCIStreamBuffer& b) { return out.write(b.data(), b.length()); }
+inline std::ostream& operator<<(std::ostream& out, const ArduinoCIStreamInput& in) { return out << in.target(); }
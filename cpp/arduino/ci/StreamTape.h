@@ -12,7 +12,7 @@ class StreamTape : public Stream, public ObservableDataStream
     // mGodmodeDataIn is provided by Stream
 
   public:
-    StreamTape(String* dataIn, String* dataOut, unsigned long* delay): Stream(), ObservableDataStream() {
+    StreamTape(ArduinoCIStreamInput dataIn, String* dataOut, unsigned long* delay): Stream(), ObservableDataStream() {
       mGodmodeDataIn      = dataIn;
       mGodmodeDataOut     = dataOut;
       mGodmodeMicrosDelay = delay;
@@ -24,11 +24,18 @@ class StreamTape : public Stream, public ObservableDataStream
     // virtual int availableForWrite(void);
     // virtual void flush(void);
     virtual size_t write(uint8_t aChar) {
-      mGodmodeDataOut->append(String((char)aChar));
+      mGodmodeDataOut->push_back((char)aChar);
       advertiseByte((unsigned char)aChar);
       return 1;
     }
 
+    // the whole buffer is recorded in one append, and observers hear about it once
+    virtual size_t write(const uint8_t *buffer, size_t size) {
+      mGodmodeDataOut->append((const char*)buffer, size);
+      advertiseBytes(buffer, size);
+      return size;
+    }
+
     // https://stackoverflow.com/a/4271276
     using Print::write; // pull in write(str) and write(buf, size) from Print
 
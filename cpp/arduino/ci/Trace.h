@@ -0,0 +1,403 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+#if defined(_WIN32)
+  #include <fstream>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+#include "../Godmode.h"
+#include "../Wire.h"
+
+// Recorded traces of pins and byte streams, replayed into GODMODE() by virtual time.
+//
+// A trace is a set of channels, each a time-ordered run of (micros, value) samples for one
+// digital pin, analog pin, serial port, the SPI bus, or one Wire slave.  Binary traces are
+// memory-mapped and replayed straight from the mapping, so a capture of any size costs
+// address space rather than heap, and nothing is allocated per sample.
+//
+// Binary format, little-endian:
+//   header:   char magic[8] = "ACITRACE"; uint32 version = 1; uint32 channelCount
+//   channels: channelCount x { uint8 kind; uint8 reserved; uint16 index; uint32 reserved;
+//                              uint64 offset; uint64 count }
+//   samples:  at each channel's offset (from the start of the file, 8-byte aligned),
+//             count x { uint64 micros; int64 value }, in time order
+//
+// CSV format: one "micros,channel,value" sample per line, where channel is D<pin>, A<pin>,
+// S<port>, SPI, or W<address>.  Blank lines, lines starting with # and a header line are skipped.
+// CSV is parsed in place from the mapped file into one array per channel.
+class ArduinoCITrace {
+  public:
+    enum Kind {
+      TRACE_DIGITAL = 0,
+      TRACE_ANALOG  = 1,
+      TRACE_SERIAL  = 2,
+      TRACE_SPI     = 3,
+      TRACE_WIRE    = 4
+    };
+
+    struct Sample {
+      uint64_t micros;
+      int64_t value;
+    };
+
+    struct Channel {
+      uint8_t kind;
+      uint16_t index;
+      const Sample* samples;
+      uint64_t count;
+    };
+
+  private:
+    struct ChannelHeader {
+      uint8_t kind;
+      uint8_t reserved0;
+      uint16_t index;
+      uint32_t reserved1;
+      uint64_t offset;
+      uint64_t count;
+    };
+
+    // the bytes of a trace file, mapped (or on Windows, read) and released when the last user lets go
+    class Mapping {
+      private:
+        const char* mData;
+        size_t mSize;
+#if defined(_WIN32)
+        std::vector<char> mBuffer;
+#endif
+
+      public:
+        Mapping() : mData(nullptr), mSize(0) { }
+
+        bool open(const char* path) {
+#if defined(_WIN32)
+          std::ifstream in(path, std::ios::binary);
+          if (!in) return false;
+          mBuffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+          mData = mBuffer.data();
+          mSize = mBuffer.size();
+          return true;
+#else
+          int fd = ::open(path, O_RDONLY);
+          if (fd < 0) return false;
+          struct stat st;
+          if (fstat(fd, &st) != 0) {
+            close(fd);
+            return false;
+          }
+          mSize = st.st_size;
+          if (mSize) {
+            void* p = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+              close(fd);
+              return false;
+            }
+            mData = (const char*)p;
+          }
+          close(fd);  // the mapping stays valid
+          return true;
+#endif
+        }
+
+        ~Mapping() {
+#if !defined(_WIN32)
+          if (mData) munmap((void*)mData, mSize);
+#endif
+        }
+
+        inline const char* data() const { return mData; }
+        inline size_t size() const { return mSize; }
+    };
+
+    // a pin's input read from a channel: the value of the latest sample at or before the time.
+    // like PinHistory's own timeline, a cursor makes polling amortized O(1)
+    class Signal {
+      private:
+        std::shared_ptr<const void> mKeep;
+        const Sample* mSamples;
+        uint64_t mCount;
+        mutable uint64_t mPos;
+
+      public:
+        Signal(std::shared_ptr<const void> keep, const Channel& c) : mKeep(keep), mSamples(c.samples), mCount(c.count), mPos(0) { }
+
+        long operator()(unsigned long micros) const {
+          if (mCount == 0 || mSamples[0].micros > micros) return 0;
+          if (mSamples[mPos].micros <= micros) {
+            for (int steps = 0; steps < 8; ++steps) {
+              if (mPos + 1 >= mCount || mSamples[mPos + 1].micros > micros) return (long)mSamples[mPos].value;
+              ++mPos;
+            }
+          }
+          uint64_t lo = 0;
+          uint64_t hi = mCount;
+          while (lo < hi) {
+            uint64_t mid = lo + (hi - lo) / 2;
+            if (mSamples[mid].micros <= micros) {
+              lo = mid + 1;
+            } else {
+              hi = mid;
+            }
+          }
+          mPos = lo - 1;
+          return (long)mSamples[mPos].value;
+        }
+    };
+
+    // delivers a byte channel's samples into its buffer as the clock reaches them.  it keeps one
+    // event scheduled at a time: the next sample's, posted without allocation.  the event shares
+    // ownership of the feed, so a snapshot's copy of it can never outlive the feed; once detached,
+    // a feed ignores any such copies that are still pending
+    struct ByteFeed {
+      GodmodeState* state;
+      Channel channel;
+      uint64_t pos;
+      unsigned long eventId;
+      bool attached;
+      std::weak_ptr<ByteFeed> self;  // for the events to share ownership
+
+      static void run(void* context, unsigned long due) {
+        ByteFeed* f = (ByteFeed*)context;
+        if (!f->attached) return;
+        unsigned long now = f->state->now();
+
+        // the event was posted for the first sample not yet delivered, due then.  start from
+        // there rather than from pos, which may belong to another timeline: a snapshot restored
+        // since (backward or forward) brings back whichever event was pending in it
+        const Sample* s = f->channel.samples;
+        f->pos = std::lower_bound(s, s + f->channel.count, due, [](const Sample& a, unsigned long t) { return a.micros < t; }) - s;
+
+        for (; f->pos < f->channel.count && f->channel.samples[f->pos].micros <= now; ++f->pos) {
+          char c = (char)f->channel.samples[f->pos].value;
+          switch (f->channel.kind) {
+            case TRACE_SERIAL: f->state->serialPort[f->channel.index].dataIn.concat(c); break;
+            case TRACE_SPI:    f->state->spi.dataIn.concat(c); break;
+            case TRACE_WIRE:   f->state->wire()->getMiso(f->channel.index)->push_back((uint8_t)c); break;
+          }
+        }
+        f->schedule();
+      }
+
+      void schedule() {
+        eventId = 0;
+        if (pos < channel.count) eventId = state->scheduleAt(channel.samples[pos].micros, &ByteFeed::run, this, self.lock());
+      }
+    };
+
+    std::shared_ptr<const Mapping> mMapping;            // for binary traces
+    std::shared_ptr<std::vector<std::vector<Sample> > > mParsed;  // for CSV traces
+    std::vector<Channel> mChannels;
+    std::vector<std::shared_ptr<ByteFeed> > mFeeds;
+
+    static const char* magic() { return "ACITRACE"; }
+
+    std::shared_ptr<const void> keepAlive() const {
+      if (mMapping) return mMapping;
+      return mParsed;
+    }
+
+    // read an unsigned decimal number, advancing p.  false if there are no digits
+    static bool parseNumber(const char*& p, const char* end, uint64_t& out) {
+      const char* start = p;
+      out = 0;
+      while (p < end && *p >= '0' && *p <= '9') out = out * 10 + (*p++ - '0');
+      return p != start;
+    }
+
+    static bool parseChannel(const char*& p, const char* end, uint8_t& kind, uint16_t& index) {
+      uint64_t n = 0;
+      if (end - p >= 3 && strncmp(p, "SPI", 3) == 0) {
+        p += 3;
+        kind = TRACE_SPI;
+        index = 0;
+        return true;
+      }
+      if (p >= end) return false;
+      switch (*p++) {
+        case 'D': kind = TRACE_DIGITAL; break;
+        case 'A': kind = TRACE_ANALOG;  break;
+        case 'S': kind = TRACE_SERIAL;  break;
+        case 'W': kind = TRACE_WIRE;    break;
+        default: return false;
+      }
+      if (!parseNumber(p, end, n)) return false;
+      index = (uint16_t)n;
+      return true;
+    }
+
+    void clear() {
+      detach();
+      mMapping.reset();
+      mParsed.reset();
+      mChannels.clear();
+    }
+
+  public:
+    ArduinoCITrace() { }
+    ~ArduinoCITrace() { detach(); }
+
+    // the feeds belong to this object
+    ArduinoCITrace(const ArduinoCITrace&) = delete;
+    void operator=(const ArduinoCITrace&) = delete;
+
+    const std::vector<Channel>& channels() const { return mChannels; }
+
+    // map a binary trace.  false if the file can't be read or isn't a well-formed trace
+    bool openBinary(const char* path) {
+      clear();
+      std::shared_ptr<Mapping> m(new Mapping());
+      if (!m->open(path)) return false;
+      const char* d = m->data();
+      size_t size = m->size();
+      if (size < 16 || memcmp(d, magic(), 8) != 0) return false;
+      uint32_t version;
+      uint32_t count;
+      memcpy(&version, d + 8, 4);
+      memcpy(&count, d + 12, 4);
+      if (version != 1 || 16 + (uint64_t)count * sizeof(ChannelHeader) > size) return false;
+
+      for (uint32_t i = 0; i < count; ++i) {
+        ChannelHeader h;
+        memcpy(&h, d + 16 + i * sizeof(ChannelHeader), sizeof(h));
+        if (h.offset % 8 || h.offset > size || h.count > (size - h.offset) / sizeof(Sample)) {
+          mChannels.clear();
+          return false;
+        }
+        Channel c = { h.kind, h.index, (const Sample*)(d + h.offset), h.count };
+        mChannels.push_back(c);
+      }
+      mMapping = m;
+      return true;
+    }
+
+    // read a CSV trace.  false if the file can't be read or a line can't be parsed
+    bool openCSV(const char* path) {
+      clear();
+      Mapping m;
+      if (!m.open(path)) return false;
+      std::shared_ptr<std::vector<std::vector<Sample> > > parsed(new std::vector<std::vector<Sample> >());
+      std::vector<std::pair<uint8_t, uint16_t> > keys;
+
+      const char* p = m.data();
+      const char* end = p + m.size();
+      bool first = true;
+      while (p < end) {
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (eol == nullptr) eol = end;
+        const char* q = p;
+        uint64_t t;
+        uint64_t v;
+        uint8_t kind;
+        uint16_t index;
+        bool isHeader = first && p < eol && (*p < '0' || *p > '9') && *p != '#';
+        first = false;
+        if (p == eol || *p == '#' || *p == '\r' || isHeader) {
+          p = eol + 1;
+          continue;
+        }
+        if (!parseNumber(q, eol, t) || q >= eol || *q++ != ',' || !parseChannel(q, eol, kind, index)
+            || q >= eol || *q++ != ',') return false;
+        bool negative = q < eol && *q == '-';
+        if (negative) ++q;
+        if (!parseNumber(q, eol, v)) return false;
+
+        unsigned int k = 0;
+        while (k < keys.size() && (keys[k].first != kind || keys[k].second != index)) ++k;
+        if (k == keys.size()) {
+          keys.push_back(std::make_pair(kind, index));
+          parsed->push_back(std::vector<Sample>());
+        }
+        Sample s = { t, negative ? -(int64_t)v : (int64_t)v };
+        (*parsed)[k].push_back(s);
+        p = eol + 1;
+      }
+
+      for (unsigned int k = 0; k < keys.size(); ++k) {
+        std::vector<Sample>& samples = (*parsed)[k];
+        // CSV lines needn't be in order; stable so equal times keep their order
+        std::stable_sort(samples.begin(), samples.end(), [](const Sample& a, const Sample& b) { return a.micros < b.micros; });
+        Channel c = { keys[k].first, keys[k].second, samples.data(), samples.size() };
+        mChannels.push_back(c);
+      }
+      mParsed = parsed;
+      return true;
+    }
+
+    // write the channels as a binary trace, e.g. to convert a CSV capture once for faster loading
+    bool saveBinary(const char* path) const {
+      FILE* f = fopen(path, "wb");
+      if (f == nullptr) return false;
+      uint32_t version = 1;
+      uint32_t count = mChannels.size();
+      bool ok = fwrite(magic(), 1, 8, f) == 8 && fwrite(&version, 4, 1, f) == 1 && fwrite(&count, 4, 1, f) == 1;
+      uint64_t offset = 16 + count * sizeof(ChannelHeader);
+      offset = (offset + 7) / 8 * 8;
+      for (uint32_t i = 0; ok && i < count; ++i) {
+        ChannelHeader h = { mChannels[i].kind, 0, mChannels[i].index, 0, offset, mChannels[i].count };
+        ok = fwrite(&h, sizeof(h), 1, f) == 1;
+        offset += mChannels[i].count * sizeof(Sample);
+      }
+      for (uint64_t pad = 16 + count * sizeof(ChannelHeader); ok && pad % 8; ++pad) ok = fputc(0, f) != EOF;
+      for (uint32_t i = 0; ok && i < count; ++i) {
+        ok = fwrite(mChannels[i].samples, sizeof(Sample), mChannels[i].count, f) == mChannels[i].count;
+      }
+      return fclose(f) == 0 && ok;
+    }
+
+    // feed the channels into a Godmode state (by default, the current thread's).  pins take
+    // their input from the trace as a generator (see PinHistory::setGenerator); serial, SPI and
+    // Wire bytes are appended to their input buffers as the clock reaches them.  channels for
+    // pins or ports the board doesn't have are ignored
+    void replay(GodmodeState* state = GODMODE()) {
+      detach();
+      for (unsigned int i = 0; i < mChannels.size(); ++i) {
+        const Channel& c = mChannels[i];
+        switch (c.kind) {
+          case TRACE_DIGITAL:
+            if (c.index < MOCK_PINS_COUNT) state->digitalPin[c.index].setGenerator(Signal(keepAlive(), c));
+            break;
+          case TRACE_ANALOG:
+            if (c.index < MOCK_PINS_COUNT) state->analogPin[c.index].setGenerator(Signal(keepAlive(), c));
+            break;
+          case TRACE_SERIAL:
+            if (c.index >= NUM_SERIAL_PORTS) break;
+            // fall through
+          case TRACE_SPI:
+          case TRACE_WIRE: {
+            if (c.kind == TRACE_WIRE && (c.index == 0 || c.index >= SLAVE_COUNT)) break;
+            std::shared_ptr<ByteFeed> f(new ByteFeed());
+            f->state = state;
+            f->channel = c;
+            f->pos = 0;
+            f->attached = true;
+            f->self = f;
+            f->schedule();
+            mFeeds.push_back(f);
+            break;
+          }
+        }
+      }
+    }
+
+    // stop feeding byte channels.  pins keep their generators until reset.  pending events are
+    // cancelled if their state is the current thread's and still exists; any others (including
+    // copies held by snapshots) just do nothing when they fall due
+    void detach() {
+      GodmodeState* current = GodmodeState::existingInstance();
+      for (unsigned int i = 0; i < mFeeds.size(); ++i) {
+        ByteFeed* f = mFeeds[i].get();
+        f->attached = false;
+        if (f->eventId && f->state == current) f->state->cancelScheduled(f->eventId);
+      }
+      mFeeds.clear();
+    }
+};
@@ -1,65 +1,23 @@
-
-#if 1 // This code is copied from https://people.cs.umu.se/isak/snippets/ltoa.c and then converted from ltoa to itoa.
-/*
-**  LTOA.C
-**
-**  Converts a integer to a string.
-**
-**  Copyright 1988-90 by Robert B. Stout dba MicroFirm
-**
-**  Released to public domain, 1991
-**
-**  Parameters: 1 - number to be converted
-**              2 - buffer in which to build the converted string
-**              3 - number base to use for conversion
-**
-**  Returns:  A character pointer to the converted string if
-**            successful, a NULL pointer if the number base specified
-**            is out of range.
-*/
-
-#include <stdio.h>
 #include <stdlib.h>
-#include <string.h>
-
-#define BUFSIZE (sizeof(int) * 8 + 1)
-
-char *itoa(int N, char *str, int base)
-{
-      int i = 2;
-      int uarg;
-      char *tail, *head = str, buf[BUFSIZE];
-
-      if (36 < base || 2 > base)
-            base = 10;                    /* can only use 0-9, A-Z        */
-      tail = &buf[BUFSIZE - 1];           /* last character position      */
-      *tail-- = '\0';
-
-      if (10 == base && N < 0L)
-      {
-            *head++ = '-';
-            uarg    = -N;
-      }
-      else  uarg = N;
-
-      if (uarg)
-      {
-            for (i = 1; uarg; ++i)
-            {
-                  ldiv_t r;
-
-                  r       = ldiv(uarg, base);
-                  *tail-- = (char)(r.rem + ((9L < r.rem) ?
-                                  ('A' - 10L) : '0'));
-                  uarg    = r.quot;
-            }
-      }
-      else  *tail-- = '0';
-
-      memcpy(head, ++tail, i);
-      return str;
+#include "ci/NumberFormat.h"
+
+// the avr-libc integer conversions: lowercase digits, a minus sign only in base 10 (other bases
+// show the two's complement), and an empty string for a base outside 2-36
+
+template <typename T>
+static char *toText(T val, char *s, int radix) {
+  char buf[ArduinoCINumberFormat::INTEGER_CHARS];
+  char *end = buf + sizeof(buf);
+  char *first = ArduinoCINumberFormat::libc(val, radix, end);
+  memcpy(s, first, end - first);
+  s[end - first] = '\0';
+  return s;
 }
-#endif
+
+char *itoa(int val, char *s, int radix) { return toText(val, s, radix); }
+char *utoa(unsigned int val, char *s, int radix) { return toText(val, s, radix); }
+char *ltoa(long val, char *s, int radix) { return toText(val, s, radix); }
+char *ultoa(unsigned long val, char *s, int radix) { return toText(val, s, radix); }
 
  /*
  The dtostrf() function converts the double value passed in val into
@@ -76,6 +34,8 @@ char *itoa(int N, char *str, int base)
  */
 
  char *dtostrf(double __val, signed char __width, unsigned char __prec, char *__s) {
-       sprintf(__s, "%*.*f", __width, __prec, __val);
+       char buf[ArduinoCINumberFormat::FLOAT_CHARS];
+       size_t n = ArduinoCINumberFormat::dtostrf(__val, __width, __prec, buf);
+       memcpy(__s, buf, n + 1);
        return __s;
  }
@@ -6,12 +6,15 @@
 #include_next <stdlib.h>
 
 /*
- * Arduino stdlib.h includes a prototype for itoa which is not a standard function,
- * and is not available in /usr/include/stdlib.h. Provide one here.
+ * Arduino stdlib.h includes prototypes for itoa (and utoa, ltoa, ultoa) which are not standard functions,
+ * and are not available in /usr/include/stdlib.h. Provide them here.
  * http://www.cplusplus.com/reference/cstdlib/itoa/
  * https://stackoverflow.com/questions/190229/where-is-the-itoa-function-in-linux
  */
 char *itoa(int val, char *s, int radix);
+char *utoa(unsigned int val, char *s, int radix);
+char *ltoa(long val, char *s, int radix);
+char *ultoa(unsigned long val, char *s, int radix);
 
  // another function provided by Arduino
  char * 	dtostrf(double __val, signed char __width, unsigned char __prec, char *__s);
@@ -1,6 +1,7 @@
 #pragma once
 #include <avr/pgmspace.h>
 #include <WString.h>
+#include <ci/StreamBuffer.h>
 
 template  < typename A, typename B > struct Compare
 {
@@ -104,6 +105,17 @@ eqComparisonTemplateMacro(char, [N], const char *, ,
 eqComparisonTemplateMacro(char, [N], char *, ,                                           strcmp(a,b), size_t N)
 eqComparisonTemplateMacro(char, [N], char, [M],                                          strcmp(a,b), size_t N, size_t M)
 
+// stream input buffers compare like the Strings they stand in for
+eqComparisonTemplateMacro(ArduinoCIStreamBuffer, , ArduinoCIStreamBuffer, ,              a.compareTo(b))
+eqComparisonTemplateMacro(ArduinoCIStreamBuffer, , String, ,                             a.compareTo(b))
+eqComparisonTemplateMacro(ArduinoCIStreamBuffer, , const char *, ,                       a.compareTo(b))
+eqComparisonTemplateMacro(ArduinoCIStreamBuffer, , char *, ,                             a.compareTo(b))
+eqComparisonTemplateMacro(ArduinoCIStreamBuffer, , char, [M],                            a.compareTo(b), size_t M)
+eqComparisonTemplateMacro(String, , ArduinoCIStreamBuffer, ,                             -b.compareTo(a))
+eqComparisonTemplateMacro(const char *, , ArduinoCIStreamBuffer, ,                       -b.compareTo(a))
+eqComparisonTemplateMacro(char *, , ArduinoCIStreamBuffer, ,                             -b.compareTo(a))
+eqComparisonTemplateMacro(char, [N], ArduinoCIStreamBuffer, ,                            -b.compareTo(a), size_t N)
+
 eqComparisonTemplateMacro(A, , std::nullptr_t, ,                                         a ? 1 : 0, typename A)
 eqComparisonTemplateMacro(std::nullptr_t, , B, ,                                         b ? -1 : 0, typename B)
 
@@ -495,7 +495,7 @@ module ArduinoCI
     def build_for_test(test_file, gcc_binary)
       executable = Pathname.new("#{BUILD_DIR}/#{test_file.basename}.bin").expand_path
       File.delete(executable) if File.exist?(executable)
-      arg_sets = ["-std=c++0x", "-o", executable.to_s, "-L#{BUILD_DIR}", "-DARDUINO=100"]
+      arg_sets = ["-std=c++0x", "-pthread", "-o", executable.to_s, "-L#{BUILD_DIR}", "-DARDUINO=100"]
       if libasan?(gcc_binary)
         arg_sets << [ # Stuff to help with dynamic memory mishandling
           "-g", "-O1",
@@ -537,7 +537,7 @@ module ArduinoCI
       full_lib_name = "#{BUILD_DIR}/lib#{LIBRARY_NAME}.#{suffix}"
       executable = Pathname.new(full_lib_name).expand_path
       File.delete(executable) if File.exist?(executable)
-      arg_sets = ["-std=c++0x", "-shared", "-fPIC", "-Wl,-undefined,dynamic_lookup",
+      arg_sets = ["-std=c++0x", "-pthread", "-shared", "-fPIC", "-Wl,-undefined,dynamic_lookup",
                   "-o", executable.to_s, "-L#{BUILD_DIR}", "-DARDUINO=100"]
       if libasan?(gcc_binary)
         arg_sets << [ # Stuff to help with dynamic memory mishandling